@@ -0,0 +1,114 @@
+#ifndef ALLOC_COUNT_HPP_INCLUDED
+#define ALLOC_COUNT_HPP_INCLUDED
+
+// Allocation counting for uri-test and uri-bench.  Include it in just
+// one source file of a program: it replaces the global operator new,
+// and with glibc puts a counter in front of malloc as well.
+//
+// operator new sees this library's allocations, and those the standard
+// library makes for it.  malloc also sees libidn2's and libunistring's,
+// which change from one version of them to the next.  The malloc
+// counter is left out under AddressSanitizer and ThreadSanitizer, which
+// bring their own malloc.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define ALLOC_COUNT_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define ALLOC_COUNT_SANITIZED 1
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(ALLOC_COUNT_SANITIZED)
+#define ALLOC_COUNT_MALLOC 1
+#endif
+
+namespace alloc_count {
+
+// Threads allocate too, so both are atomic; nothing is ordered by them.
+inline std::atomic<unsigned long> news{0};    // operator new
+inline std::atomic<unsigned long> mallocs{0}; // malloc, calloc and realloc
+
+#ifdef ALLOC_COUNT_MALLOC
+constexpr bool counts_malloc = true;
+#else
+constexpr bool counts_malloc = false;
+#endif
+
+inline void count(std::atomic<unsigned long>& counter)
+{
+  counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Every allocation so far: all of malloc's where it is counted,
+// otherwise operator new's.
+inline unsigned long all()
+{
+  return (counts_malloc ? mallocs : news).load(std::memory_order_relaxed);
+}
+
+} // namespace alloc_count
+
+// The number of allocations fn() makes through operator new: this
+// library's own, whatever the versions of libidn2 and libunistring.
+template <typename Fn>
+unsigned long allocations_in(Fn fn)
+{
+  auto const before = alloc_count::news.load(std::memory_order_relaxed);
+  fn();
+  return alloc_count::news.load(std::memory_order_relaxed) - before;
+}
+
+// The number of calls to malloc, calloc and realloc fn() makes, from
+// anywhere; zero where they aren't counted.
+template <typename Fn>
+unsigned long mallocs_in(Fn fn)
+{
+  auto const before = alloc_count::mallocs.load(std::memory_order_relaxed);
+  fn();
+  return alloc_count::mallocs.load(std::memory_order_relaxed) - before;
+}
+
+void* operator new(std::size_t size)
+{
+  alloc_count::count(alloc_count::news);
+  if (auto const ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+#ifdef ALLOC_COUNT_MALLOC
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+
+void* malloc(std::size_t size)
+{
+  alloc_count::count(alloc_count::mallocs);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size)
+{
+  alloc_count::count(alloc_count::mallocs);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, std::size_t size)
+{
+  alloc_count::count(alloc_count::mallocs);
+  return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+#endif // ALLOC_COUNT_HPP_INCLUDED
@@ -0,0 +1,234 @@
+#define BUILDING_DLL
+#include "binary.hpp"
+
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+using uri::binary::detail::record_head;
+using uri::binary::detail::span;
+
+constexpr char magic[8] = {'U', 'R', 'I', 'B', 'I', 'N', '0', '1'};
+
+// magic, record count, checksum
+constexpr std::size_t header_size = sizeof(magic) + 3 * sizeof(std::uint64_t);
+
+constexpr std::size_t address_size = sizeof(uri::ip_address);
+static_assert(address_size == 16);
+
+constexpr std::size_t padded(std::size_t n)
+{
+  return (n + 7) & ~std::size_t{7};
+}
+
+// The whole of a record, head to padding.
+std::size_t record_size(record_head const& head)
+{
+  auto const address
+      = (head.flags & record_head::has_address) ? address_size : 0;
+  return padded(sizeof(record_head) + address + head.length);
+}
+
+span make_span(std::size_t                       offset,
+               std::optional<std::string> const& component)
+{
+  span s;
+  if (component) {
+    s.offset = static_cast<std::uint16_t>(offset);
+    s.length = static_cast<std::uint16_t>(component->size());
+  }
+  return s;
+}
+
+std::size_t size_of(std::optional<std::string> const& component)
+{
+  return component ? component->size() : 0;
+}
+
+// The components of a uri are copies, so where each one is comes from
+// the sizes of those before it and the delimiters between them.
+void set_spans(uri::components const& parts, record_head& head)
+{
+  std::size_t at = 0;
+
+  head.scheme = make_span(at, parts.scheme);
+  if (parts.scheme)
+    at += parts.scheme->size() + 1; // ":"
+
+  if (parts.authority) {
+    at += 2; // "//"
+    head.authority = make_span(at, parts.authority);
+
+    auto host = at;
+    if (parts.userinfo) {
+      head.userinfo = make_span(at, parts.userinfo);
+      host += parts.userinfo->size() + 1; // "@"
+    }
+    head.host = make_span(host, parts.host);
+    head.port = make_span(host + size_of(parts.host) + 1, parts.port);
+
+    at += parts.authority->size();
+  }
+
+  head.path = make_span(at, parts.path);
+  at += size_of(parts.path);
+
+  if (parts.query) {
+    head.query = make_span(at + 1, parts.query); // "?"
+    at += parts.query->size() + 1;
+  }
+  head.fragment = make_span(at + 1, parts.fragment); // "#"
+}
+
+} // namespace
+
+namespace uri {
+namespace binary {
+
+void writer::add(uri const& u)
+{
+  auto const& text  = u.string();
+  auto const& parts = u.parts();
+  if (text.size() >= span::undefined)
+    throw length_error();
+
+  record_head head{};
+  head.length    = static_cast<std::uint16_t>(text.size());
+  head.host_type = parts.host_type;
+  if (u.normalized())
+    head.flags |= record_head::normalized;
+  if (parts.port_number) {
+    head.flags |= record_head::has_port_number;
+    head.port_number = *parts.port_number;
+  }
+  auto const has_address = (parts.host_type == host_kind::IPv4)
+                           || (parts.host_type == host_kind::IPv6);
+  if (has_address)
+    head.flags |= record_head::has_address;
+
+  set_spans(parts, head);
+
+  auto const start = records_.size();
+  records_.resize(start + record_size(head));
+  auto p = &records_[start];
+  std::memcpy(p, &head, sizeof(head));
+  p += sizeof(head);
+  if (has_address) {
+    std::memcpy(p, &parts.address, address_size);
+    p += address_size;
+  }
+  std::memcpy(p, text.data(), text.size());
+
+  ++size_;
+}
+
+void writer::save(std::string const& path) const
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+  auto const          sum      = fingerprint_of(records_);
+  std::uint64_t const header[] = {size_, sum.h1, sum.h2};
+  file.write(magic, sizeof(magic));
+  file.write(reinterpret_cast<char const*>(header), sizeof(header));
+  file.write(records_.data(), records_.size());
+
+  if (!file.flush())
+    throw std::runtime_error("can't write " + path);
+}
+
+std::optional<std::uint16_t> record::port_number() const
+{
+  if (head_->flags & detail::record_head::has_port_number)
+    return head_->port_number;
+  return {};
+}
+
+ip_address record::address() const
+{
+  ip_address address{};
+  if (head_->flags & detail::record_head::has_address)
+    std::memcpy(&address, head_ + 1, address_size);
+  return address;
+}
+
+component_views record::parts() const
+{
+  component_views parts;
+  parts.scheme      = scheme();
+  parts.authority   = authority();
+  parts.userinfo    = userinfo();
+  parts.host        = host();
+  parts.port        = port();
+  parts.path        = path();
+  parts.query       = query();
+  parts.fragment    = fragment();
+  parts.host_type   = host_type();
+  parts.port_number = port_number();
+  parts.address     = address();
+  return parts;
+}
+
+char const* record::data() const
+{
+  auto const p = reinterpret_cast<char const*>(head_ + 1);
+  return (head_->flags & detail::record_head::has_address) ? (p + address_size)
+                                                        : p;
+}
+
+char const* record::next() const
+{
+  return reinterpret_cast<char const*>(head_) + record_size(*head_);
+}
+
+reader::reader(std::string const& path, verify check)
+{
+  map_ = uri_internal::map_file(path, map_size_);
+  if (map_size_ < header_size)
+    throw std::runtime_error("not a file of URIs: " + path);
+
+  auto const    bytes = static_cast<char const*>(map_.get());
+  std::uint64_t header[3];
+  std::memcpy(header, bytes + sizeof(magic), sizeof(header));
+  first_ = bytes + header_size;
+  last_  = bytes + map_size_;
+  size_  = header[0];
+
+  auto ok = !std::memcmp(bytes, magic, sizeof(magic));
+  if (ok && (check == verify::checksum)) {
+    auto const sum = fingerprint_of(std::string_view(first_, last_ - first_));
+    ok             = (sum.h1 == header[1]) && (sum.h2 == header[2]);
+  }
+  if (!ok)
+    throw std::runtime_error("not a file of URIs: " + path);
+}
+
+reader::~reader() = default;
+
+reader::reader(reader&& other) noexcept
+  : map_(std::move(other.map_))
+  , map_size_(std::exchange(other.map_size_, 0))
+  , first_(std::exchange(other.first_, nullptr))
+  , last_(std::exchange(other.last_, nullptr))
+  , size_(std::exchange(other.size_, 0))
+{
+}
+
+reader& reader::operator=(reader&& other) noexcept
+{
+  if (this != &other) {
+    map_      = std::move(other.map_);
+    map_size_ = std::exchange(other.map_size_, 0);
+    first_    = std::exchange(other.first_, nullptr);
+    last_     = std::exchange(other.last_, nullptr);
+    size_     = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+} // namespace binary
+} // namespace uri
@@ -0,0 +1,216 @@
+#ifndef BINARY_HPP_INCLUDED
+#define BINARY_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A file of parsed URIs that loads with no parse.  Each record keeps
+// what the parser found along with the URI's bytes: the offset and
+// length of each component, the form, the host kind, the port number
+// and the address.  A reader maps the file and hands out records that
+// point into it, with nothing checked and nothing copied.
+//
+//   uri::binary::writer w;
+//   for (auto const& u : uris)
+//     w.add(u);
+//   w.save("uris.bin");
+//   ...
+//   uri::binary::reader r("uris.bin");
+//   for (auto const& rec : r)
+//     route(rec.host(), rec.path());
+//
+// Numbers are written as the writer's machine holds them, so a reader
+// on a machine of the other endianness can't use the file.  The layout:
+//
+//   "URIBIN01", record count, checksum (16 octets), then the records,
+//   each a 40 octet head, 16 octets of address for IPv4 and IPv6 hosts,
+//   and the URI, padded to a multiple of 8.
+//
+// Since nothing is checked, a record is only as good as the file; read
+// only files a writer made.  verify::checksum costs a pass over the
+// file to hash it, but no parse.
+
+namespace uri {
+namespace binary {
+
+namespace detail {
+struct span {
+  static constexpr std::uint16_t undefined = 0xFFFF;
+
+  std::uint16_t offset{undefined};
+  std::uint16_t length{0};
+};
+
+struct record_head {
+  enum flag : std::uint8_t {
+    normalized      = 1 << 0,
+    has_port_number = 1 << 1,
+    has_address     = 1 << 2, // 16 octets follow the head
+  };
+
+  std::uint16_t length; // of the URI
+  std::uint8_t  flags;
+  host_kind     host_type;
+  std::uint16_t port_number;
+  std::uint16_t reserved;
+
+  // clang-format off
+  span scheme;
+  span authority;
+  span userinfo;
+  span host;
+  span port;
+  span path;
+  span query;
+  span fragment;
+  // clang-format on
+};
+static_assert(sizeof(record_head) == 40);
+} // namespace detail
+
+class DLL_PUBLIC writer {
+public:
+  // Throws length_error for a URI of 64 KiB or more.
+  void add(uri const& u);
+
+  std::uint64_t size() const { return size_; } // number added
+
+  void save(std::string const& path) const;
+
+private:
+  std::string   records_;
+  std::uint64_t size_{0};
+};
+
+// One URI, as it was when added, pointing into the reader's map.
+class DLL_PUBLIC record {
+public:
+  // clang-format off
+  auto scheme()    const { return get_(head_->scheme); }
+  auto authority() const { return get_(head_->authority); }
+  auto userinfo()  const { return get_(head_->userinfo); }
+  auto host()      const { return get_(head_->host); }
+  auto port()      const { return get_(head_->port); }
+  auto path()      const { return get_(head_->path); }
+  auto query()     const { return get_(head_->query); }
+  auto fragment()  const { return get_(head_->fragment); }
+  // clang-format on
+
+  host_kind                    host_type() const { return head_->host_type; }
+  std::optional<std::uint16_t> port_number() const;
+  ip_address                   address() const;
+
+  component_views parts() const;
+
+  std::string_view string() const { return {data(), head_->length}; }
+
+  bool normalized() const
+  {
+    return head_->flags & detail::record_head::normalized;
+  }
+
+private:
+  friend class reader;
+
+  explicit record(char const* p)
+    : head_(reinterpret_cast<detail::record_head const*>(p))
+  {
+  }
+
+  char const* data() const;
+  char const* next() const; // the record after this one
+
+  std::optional<std::string_view> get_(detail::span s) const
+  {
+    if (s.offset == detail::span::undefined)
+      return {};
+    return std::string_view(data() + s.offset, s.length);
+  }
+
+  detail::record_head const* head_;
+};
+
+// What reader checks before handing out records.
+enum class verify : bool {
+  none,     // just the magic
+  checksum, // the records are what the writer wrote
+};
+
+class DLL_PUBLIC reader {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = record;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = record const*;
+    using reference         = record const&;
+
+    iterator()
+      : record_(nullptr)
+    {
+    }
+
+    reference operator*() const { return record_; }
+    pointer   operator->() const { return &record_; }
+
+    iterator& operator++()
+    {
+      record_ = record(record_.next());
+      return *this;
+    }
+    iterator operator++(int)
+    {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(iterator const& rhs) const
+    {
+      return record_.head_ == rhs.record_.head_;
+    }
+    bool operator!=(iterator const& rhs) const { return !(*this == rhs); }
+
+  private:
+    friend class reader;
+
+    explicit iterator(char const* p)
+      : record_(p)
+    {
+    }
+
+    record record_;
+  };
+
+  // Throws std::runtime_error if path can't be mapped, is not a file
+  // of records, or fails the check.
+  explicit reader(std::string const& path, verify check = verify::none);
+  ~reader();
+
+  reader(reader&&) noexcept;
+  reader& operator=(reader&&) noexcept;
+
+  iterator begin() const { return iterator(first_); }
+  iterator end() const { return iterator(last_); }
+
+  std::uint64_t size() const { return size_; } // number of records
+
+private:
+  std::shared_ptr<void const> map_;
+  std::size_t                 map_size_{0};
+  char const*                 first_{nullptr};
+  char const*                 last_{nullptr};
+  std::uint64_t               size_{0};
+};
+
+} // namespace binary
+} // namespace uri
+
+#endif // BINARY_HPP_INCLUDED
@@ -0,0 +1,137 @@
+#define BUILDING_DLL
+#include "uri.hpp"
+
+#include <cstring>
+
+namespace {
+
+// MurmurHash3, by Austin Appleby, who put it in the public domain.
+
+constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+constexpr std::uint64_t rotl(std::uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+constexpr std::uint64_t fmix(std::uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+constexpr std::uint64_t mix_k1(std::uint64_t k1)
+{
+  return rotl(k1 * c1, 31) * c2;
+}
+
+constexpr std::uint64_t mix_k2(std::uint64_t k2)
+{
+  return rotl(k2 * c2, 33) * c1;
+}
+
+} // namespace
+
+namespace uri {
+
+void fingerprinter::mix(char const* block)
+{
+  std::uint64_t k1, k2;
+  std::memcpy(&k1, block, 8);
+  std::memcpy(&k2, block + 8, 8);
+
+  h1_ ^= mix_k1(k1);
+  h1_ = rotl(h1_, 27) + h2_;
+  h1_ = h1_ * 5 + 0x52dce729;
+
+  h2_ ^= mix_k2(k2);
+  h2_ = rotl(h2_, 31) + h1_;
+  h2_ = h2_ * 5 + 0x38495ab5;
+
+  length_ += 16;
+}
+
+void fingerprinter::update(std::string_view piece)
+{
+  // An empty view may have a null data(), which memcpy() must not get.
+  if (piece.empty())
+    return;
+
+  auto p   = piece.data();
+  auto end = p + piece.size();
+
+  // Top up a partial block first, then mix whole blocks straight from
+  // the piece.
+  if (used_) {
+    auto const n = std::min<std::size_t>(sizeof(block_) - used_, end - p);
+    std::memcpy(block_ + used_, p, n);
+    used_ += n;
+    p += n;
+    if (used_ < sizeof(block_))
+      return;
+    mix(block_);
+    used_ = 0;
+  }
+  for (; end - p >= 16; p += 16)
+    mix(p);
+
+  std::memcpy(block_, p, end - p);
+  used_ = end - p;
+}
+
+fingerprint fingerprinter::digest() const
+{
+  auto h1 = h1_;
+  auto h2 = h2_;
+
+  auto const tail = reinterpret_cast<unsigned char const*>(block_);
+
+  std::uint64_t k1 = 0;
+  std::uint64_t k2 = 0;
+  switch (used_) {
+  case 15: k2 ^= std::uint64_t(tail[14]) << 48; [[fallthrough]];
+  case 14: k2 ^= std::uint64_t(tail[13]) << 40; [[fallthrough]];
+  case 13: k2 ^= std::uint64_t(tail[12]) << 32; [[fallthrough]];
+  case 12: k2 ^= std::uint64_t(tail[11]) << 24; [[fallthrough]];
+  case 11: k2 ^= std::uint64_t(tail[10]) << 16; [[fallthrough]];
+  case 10: k2 ^= std::uint64_t(tail[9]) << 8; [[fallthrough]];
+  case 9: k2 ^= std::uint64_t(tail[8]); h2 ^= mix_k2(k2); [[fallthrough]];
+  case 8: k1 ^= std::uint64_t(tail[7]) << 56; [[fallthrough]];
+  case 7: k1 ^= std::uint64_t(tail[6]) << 48; [[fallthrough]];
+  case 6: k1 ^= std::uint64_t(tail[5]) << 40; [[fallthrough]];
+  case 5: k1 ^= std::uint64_t(tail[4]) << 32; [[fallthrough]];
+  case 4: k1 ^= std::uint64_t(tail[3]) << 24; [[fallthrough]];
+  case 3: k1 ^= std::uint64_t(tail[2]) << 16; [[fallthrough]];
+  case 2: k1 ^= std::uint64_t(tail[1]) << 8; [[fallthrough]];
+  case 1: k1 ^= std::uint64_t(tail[0]); h1 ^= mix_k1(k1);
+  }
+
+  auto const length = length_ + used_;
+  h1 ^= length;
+  h2 ^= length;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  return {h1, h2};
+}
+
+DLL_PUBLIC fingerprint fingerprint_of(std::string_view normalized)
+{
+  fingerprinter f;
+  f.update(normalized);
+  return f.digest();
+}
+
+} // namespace uri
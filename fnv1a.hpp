@@ -0,0 +1,33 @@
+#ifndef FNV1A_HPP_INCLUDED
+#define FNV1A_HPP_INCLUDED
+
+// The 32 bit FNV-1a hash behind the scheme table and query_index.
+// Not installed.
+
+#include <cstdint>
+#include <string_view>
+
+namespace uri_internal {
+
+struct same_octet {
+  constexpr unsigned char operator()(unsigned char c) const { return c; }
+};
+
+// FNV-1a over fold() of each octet of s, the offset basis xored with
+// seed.
+template <typename Fold = same_octet>
+constexpr std::uint32_t fnv1a(std::string_view s,
+                              std::uint32_t    seed = 0,
+                              Fold             fold = {})
+{
+  std::uint32_t h = 2166136261u ^ seed;
+  for (auto c : s) {
+    h ^= fold(static_cast<unsigned char>(c));
+    h *= 16777619u;
+  }
+  return h;
+}
+
+} // namespace uri_internal
+
+#endif // FNV1A_HPP_INCLUDED
@@ -0,0 +1,351 @@
+#ifndef GRAMMAR_HPP_INCLUDED
+#define GRAMMAR_HPP_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Hand written, constexpr replacements for grammar rules that are slow
+// as PEGTL rules.  Used by both the PEGTL grammar in uri.cpp and the
+// constexpr one in static_uri.hpp.
+
+namespace uri {
+namespace grammar {
+
+constexpr int hex_value(char ch)
+{
+  if (('0' <= ch) && (ch <= '9'))
+    return ch - '0';
+  if (('a' <= ch) && (ch <= 'f'))
+    return 10 + (ch - 'a');
+  if (('A' <= ch) && (ch <= 'F'))
+    return 10 + (ch - 'A');
+  return -1;
+}
+
+constexpr bool IPv6_char(char ch)
+{
+  return (hex_value(ch) >= 0) || (ch == ':') || (ch == '.');
+}
+
+// Parses the dotted quad at the end of an IPv6 address: four dec-octets
+// with no leading zeros, as in the IPv4address rule.
+constexpr bool IPv4_tail(std::string_view in, std::uint8_t* addr)
+{
+  std::size_t pos = 0;
+  for (auto i = 0; i < 4; ++i) {
+    if (i && ((pos == in.size()) || (in[pos++] != '.')))
+      return false;
+    auto const first = pos;
+    auto       octet = 0;
+    while ((pos < in.size()) && (pos - first < 3) && ('0' <= in[pos])
+           && (in[pos] <= '9'))
+      octet = 10 * octet + (in[pos++] - '0');
+    if ((pos == first) || (octet > 255)
+        || ((in[first] == '0') && (pos - first > 1)))
+      return false;
+    addr[i] = static_cast<std::uint8_t>(octet);
+  }
+  return pos == in.size();
+}
+
+// The IPv6address rule in a single pass, with no backtracking.
+//
+// Matches the longest run of hex digits, colons and dots at the front
+// of in, which must be all of one IPv6 address.  Inside an IP-literal
+// this accepts exactly what the nine alternatives of RFC 3986 do: the
+// closing "]" cannot follow a shorter match.
+//
+// Returns the number of chars matched, zero for no match, and fills in
+// the 16 bytes of addr in network order.
+
+constexpr std::size_t IPv6address(std::string_view in, std::uint8_t* addr)
+{
+  std::size_t len = 0;
+  while ((len < in.size()) && (len < 46) && IPv6_char(in[len]))
+    ++len;
+  if ((len < 2) || (len == 46))
+    return 0;
+  in = in.substr(0, len);
+
+  std::uint16_t groups[8]{};
+  auto          n   = 0;  // groups seen
+  auto          gap = -1; // where the "::" is
+  std::size_t   pos = 0;
+
+  if (in[0] == ':') {
+    if (in[1] != ':')
+      return 0;
+    gap = 0;
+    pos = 2;
+  }
+
+  while (pos < in.size()) {
+    if (n == 8)
+      return 0;
+
+    auto const start = pos;
+    while ((pos < in.size()) && (hex_value(in[pos]) >= 0))
+      ++pos;
+
+    if ((pos < in.size()) && (in[pos] == '.')) {
+      // ls32 as a dotted quad, must be the last thing
+      if (n > 6)
+        return 0;
+      std::uint8_t quad[4]{};
+      if (!IPv4_tail(in.substr(start), quad))
+        return 0;
+      groups[n++] = (quad[0] << 8) | quad[1];
+      groups[n++] = (quad[2] << 8) | quad[3];
+      break;
+    }
+
+    if ((pos == start) || (pos - start > 4))
+      return 0;
+    auto value = 0;
+    for (auto i = start; i < pos; ++i)
+      value = 16 * value + hex_value(in[i]);
+
+    groups[n++] = static_cast<std::uint16_t>(value);
+
+    if (pos == in.size())
+      break;
+    ++pos; // the ':'
+    if ((pos < in.size()) && (in[pos] == ':')) {
+      if (gap >= 0)
+        return 0;
+      gap = n;
+      ++pos;
+    }
+    else if (pos == in.size()) {
+      return 0; // a single trailing colon
+    }
+  }
+
+  if ((gap < 0) ? (n != 8) : (n > 7))
+    return 0;
+
+  // Slide the groups after the "::" to the end, and zero fill.
+  std::uint16_t full[8]{};
+  if (gap < 0) {
+    for (auto i = 0; i < 8; ++i)
+      full[i] = groups[i];
+  }
+  else {
+    for (auto i = 0; i < gap; ++i)
+      full[i] = groups[i];
+    auto const tail = n - gap;
+    for (auto i = 0; i < tail; ++i)
+      full[8 - tail + i] = groups[gap + i];
+  }
+  for (auto i = 0; i < 8; ++i) {
+    addr[2 * i]     = static_cast<std::uint8_t>(full[i] >> 8);
+    addr[2 * i + 1] = static_cast<std::uint8_t>(full[i] & 0xFF);
+  }
+
+  return len;
+}
+
+// The reg_name rule from uri.cpp:
+//
+//   u_let_dig  = ALPHA / DIGIT / UTF8-non-ascii / "%" <hex of ALPHA or DIGIT>
+//   dash       = "-" / "%2D"
+//   dot        = "." / "%2E"
+//   u_label    = u_let_dig *( 1*dash u_let_dig / u_let_dig )
+//   reg_name   = u_label *( dot u_label ) [ dot ]
+//
+// As PEGTL rules every octet was tried against a dozen or more
+// alternatives, and each run of hyphens was matched and then given
+// back at the end of a label.  Here each octet is looked up once in a
+// table, and only "%" and the UTF-8 lead bytes need a closer look.
+
+enum class host_class : std::uint8_t {
+  other,
+  let_dig, // ALPHA / DIGIT
+  dash,
+  dot,
+  pct,
+  UTF8_2, // lead octet of a two octet sequence
+  UTF8_3,
+  UTF8_4,
+};
+
+constexpr std::array<host_class, 256> make_host_classes()
+{
+  std::array<host_class, 256> classes{};
+  for (auto c = '0'; c <= '9'; ++c)
+    classes[c] = host_class::let_dig;
+  for (auto c = 'A'; c <= 'Z'; ++c)
+    classes[c] = host_class::let_dig;
+  for (auto c = 'a'; c <= 'z'; ++c)
+    classes[c] = host_class::let_dig;
+  classes['-'] = host_class::dash;
+  classes['.'] = host_class::dot;
+  classes['%'] = host_class::pct;
+  for (auto c = 0xC2; c <= 0xDF; ++c)
+    classes[c] = host_class::UTF8_2;
+  for (auto c = 0xE0; c <= 0xEF; ++c)
+    classes[c] = host_class::UTF8_3;
+  for (auto c = 0xF0; c <= 0xF4; ++c)
+    classes[c] = host_class::UTF8_4;
+  return classes;
+}
+
+inline constexpr auto host_classes = make_host_classes();
+
+constexpr host_class class_of(char ch)
+{
+  return host_classes[static_cast<unsigned char>(ch)];
+}
+
+// The octet encoded by the "%" HEXDIG HEXDIG at pos, or -1.
+constexpr int pct_octet(std::string_view in, std::size_t pos)
+{
+  if (in.size() - pos < 3)
+    return -1;
+  auto const hi = hex_value(in[pos + 1]);
+  auto const lo = hex_value(in[pos + 2]);
+  if ((hi < 0) || (lo < 0))
+    return -1;
+  return 16 * hi + lo;
+}
+
+// The length of the well formed UTF-8 sequence at pos, or zero.  The
+// ranges for the second octet are those of the UTF8_3 and UTF8_4 rules.
+constexpr std::size_t UTF8_non_ascii(std::string_view in, std::size_t pos)
+{
+  auto const lead = static_cast<unsigned char>(in[pos]);
+  auto const cls  = class_of(in[pos]);
+
+  std::size_t const len = (cls == host_class::UTF8_2)
+                              ? 2
+                              : (cls == host_class::UTF8_3)
+                                    ? 3
+                                    : (cls == host_class::UTF8_4) ? 4 : 0;
+  if ((len == 0) || (in.size() - pos < len))
+    return 0;
+
+  unsigned char lo = 0x80, hi = 0xBF;
+  switch (lead) {
+  case 0xE0: lo = 0xA0; break;
+  case 0xED: hi = 0x9F; break;
+  case 0xF0: lo = 0x90; break;
+  case 0xF4: hi = 0x8F; break;
+  }
+  auto const second = static_cast<unsigned char>(in[pos + 1]);
+  if ((second < lo) || (hi < second))
+    return 0;
+  for (std::size_t i = 2; i < len; ++i) {
+    auto const tail = static_cast<unsigned char>(in[pos + i]);
+    if ((tail < 0x80) || (0xBF < tail))
+      return 0;
+  }
+  return len;
+}
+
+// Length of the u_let_dig at pos, or zero.
+constexpr std::size_t u_let_dig(std::string_view in, std::size_t pos)
+{
+  if (pos == in.size())
+    return 0;
+  switch (class_of(in[pos])) {
+  case host_class::let_dig: return 1;
+  case host_class::pct: {
+    auto const octet = pct_octet(in, pos);
+    return ((octet >= 0) && (host_classes[octet] == host_class::let_dig)) ? 3
+                                                                          : 0;
+  }
+  case host_class::UTF8_2:
+  case host_class::UTF8_3:
+  case host_class::UTF8_4: return UTF8_non_ascii(in, pos);
+  default: return 0;
+  }
+}
+
+// Length of the dash or dot, as given by cls, at pos, or zero.
+constexpr std::size_t u_punct(std::string_view in, std::size_t pos,
+                              host_class cls)
+{
+  if (pos == in.size())
+    return 0;
+  auto const c = class_of(in[pos]);
+  if (c == cls)
+    return 1;
+  if ((c == host_class::pct) && (pct_octet(in, pos) >= 0)
+      && (host_classes[pct_octet(in, pos)] == cls))
+    return 3;
+  return 0;
+}
+
+// What reg_name() found, in octets after percent decoding.
+struct reg_name_stats {
+  std::size_t octets{0};        // not counting any trailing dot
+  std::size_t longest_label{0}; // ditto
+  bool        ascii{true};      // no UTF-8 anywhere
+};
+
+// The reg_name rule: returns the number of chars matched, zero for no
+// match.
+constexpr std::size_t reg_name(std::string_view in,
+                               reg_name_stats*  stats = nullptr)
+{
+  reg_name_stats st;
+  std::size_t    pos    = 0;
+  std::size_t    end    = 0;
+  auto           labels = 0;
+
+  for (;;) {
+    auto n = u_let_dig(in, pos);
+    if (n == 0)
+      break;
+
+    std::size_t label = 0;
+    for (;;) {
+      // plain ASCII letters and digits
+      while ((pos < in.size()) && (class_of(in[pos]) == host_class::let_dig)) {
+        ++pos;
+        ++label;
+      }
+      // a run of dashes only counts if a u_let_dig follows
+      auto p      = pos;
+      auto dashes = 0;
+      while (auto const d = u_punct(in, p, host_class::dash)) {
+        p += d;
+        ++dashes;
+      }
+      n = u_let_dig(in, p);
+      if (n == 0)
+        break;
+      if (in[p] == '%') {
+        label += 1;
+      }
+      else {
+        label += n;
+        st.ascii = st.ascii && (n == 1);
+      }
+      pos = p + n;
+      label += dashes;
+    }
+
+    st.octets += label + (labels++ ? 1 : 0);
+    if (st.longest_label < label)
+      st.longest_label = label;
+
+    end          = pos;
+    auto const d = u_punct(in, pos, host_class::dot);
+    if (d == 0)
+      break;
+    pos += d;
+    end = pos;
+  }
+
+  if (stats)
+    *stats = st;
+  return end;
+}
+
+} // namespace grammar
+} // namespace uri
+
+#endif // GRAMMAR_HPP_INCLUDED
@@ -0,0 +1,136 @@
+#ifndef LABEL_TRIE_HPP_INCLUDED
+#define LABEL_TRIE_HPP_INCLUDED
+
+// The trie on host labels, last label first, that router and
+// public_suffix_list are both built on.  Not installed.
+//
+// Each is built as a tree of nodes with a std::map of children, then
+// flattened breadth first into a vector of nodes and one string of label
+// text, each node's children next to one another in name order.  The
+// flat node types differ in what else they carry, but all have these
+// four members:
+//
+//   std::uint32_t label;      // offset into the label text
+//   std::uint32_t label_size;
+//   std::uint32_t children;   // index of the first
+//   std::uint32_t n_children;
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace uri_internal {
+
+constexpr std::uint32_t no_node = ~std::uint32_t{0};
+
+// Host labels come off the end, so "www.example.com" gives "com",
+// "example" and "www".
+inline bool next_label(std::string_view& host, std::string_view& label)
+{
+  if (host.empty())
+    return false;
+  auto const dot = host.rfind('.');
+  if (dot == std::string_view::npos) {
+    label = host;
+    host  = {};
+  }
+  else {
+    label = host.substr(dot + 1);
+    host  = host.substr(0, dot);
+  }
+  return true;
+}
+
+// The builder node for the labels of host below root, made as needed.
+template <typename Builder>
+Builder& add_labels(Builder& root, std::string_view host)
+{
+  auto             n = &root;
+  std::string_view label;
+  while (next_label(host, label)) {
+    auto& child = n->children[std::string(label)];
+    if (!child)
+      child = std::make_unique<Builder>();
+    n = child.get();
+  }
+  return *n;
+}
+
+// Lays out root and all below it in nodes and labels.  For each builder
+// node, fill(from, index, place) is called once its children are placed:
+// it copies the rest of from into nodes[index], and may place() other
+// builder nodes, which returns their indexes.  Placing may move nodes.
+template <typename Builder, typename Node, typename Fill>
+void flatten(Builder const&     root,
+             std::vector<Node>& nodes,
+             std::string&       labels,
+             Fill               fill)
+{
+  std::unordered_map<std::string, std::uint32_t> interned;
+
+  auto const intern = [&labels, &interned](std::string const& label) {
+    auto const [it, added] = interned.emplace(label, labels.size());
+    if (added)
+      labels += label;
+    return it->second;
+  };
+
+  std::deque<std::pair<Builder const*, std::uint32_t>> todo;
+
+  auto const place = [&nodes, &todo](Builder const* n) {
+    auto const index = static_cast<std::uint32_t>(nodes.size());
+    nodes.emplace_back();
+    todo.emplace_back(n, index);
+    return index;
+  };
+
+  place(&root);
+  while (!todo.empty()) {
+    auto const [from, index] = todo.front();
+    todo.pop_front();
+
+    auto const first = static_cast<std::uint32_t>(nodes.size());
+    for (auto const& [label, child] : from->children) {
+      auto const i        = place(child.get());
+      nodes[i].label      = intern(label);
+      nodes[i].label_size = static_cast<std::uint32_t>(label.size());
+    }
+    nodes[index].children   = first;
+    nodes[index].n_children = static_cast<std::uint32_t>(
+        from->children.size());
+
+    fill(*from, index, place);
+  }
+}
+
+// The index of parent's child with label, or no_node.
+template <typename Node>
+std::uint32_t child(std::vector<Node> const& nodes,
+                    std::string const&       labels,
+                    Node const&              parent,
+                    std::string_view         label)
+{
+  auto const first = nodes.begin() + parent.children;
+  auto const last  = first + parent.n_children;
+  auto const text  = [&labels](Node const& n) {
+    return std::string_view(labels.data() + n.label, n.label_size);
+  };
+
+  auto const it = std::lower_bound(first, last, label,
+                                   [&text](Node const& n, std::string_view l) {
+                                     return text(n) < l;
+                                   });
+  if ((it == last) || (text(*it) != label))
+    return no_node;
+  return static_cast<std::uint32_t>(it - nodes.begin());
+}
+
+} // namespace uri_internal
+
+#endif // LABEL_TRIE_HPP_INCLUDED
@@ -0,0 +1,41 @@
+#define BUILDING_DLL
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace uri_internal {
+
+std::shared_ptr<void const> map_file(std::string const& path,
+                                     std::size_t&       size)
+{
+  auto const fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("can't open " + path);
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    close(fd);
+    throw std::runtime_error("can't open " + path);
+  }
+  size = static_cast<std::size_t>(st.st_size);
+  if (size == 0) {
+    close(fd);
+    return {};
+  }
+
+  auto const bytes = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (bytes == MAP_FAILED)
+    throw std::runtime_error("can't map " + path);
+
+  return std::shared_ptr<void const>(bytes, [size](void const* p) {
+    munmap(const_cast<void*>(p), size);
+  });
+}
+
+} // namespace uri_internal
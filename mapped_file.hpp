@@ -0,0 +1,20 @@
+#ifndef MAPPED_FILE_HPP_INCLUDED
+#define MAPPED_FILE_HPP_INCLUDED
+
+// Maps the files binary::reader and table read.  Not installed.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace uri_internal {
+
+// The whole file at path, mapped read only, with its size.  The mapping
+// goes with the last copy of the pointer; an empty file gives a null
+// one.  Throws std::runtime_error if path can't be opened or mapped.
+std::shared_ptr<void const> map_file(std::string const& path,
+                                     std::size_t&       size);
+
+} // namespace uri_internal
+
+#endif // MAPPED_FILE_HPP_INCLUDED
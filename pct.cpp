@@ -0,0 +1,266 @@
+#define BUILDING_DLL
+#include "uri.hpp"
+
+#include "grammar.hpp"
+
+#include <array>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using uri::encoding;
+
+constexpr std::uint8_t bit(encoding ctx)
+{
+  return 1 << static_cast<int>(ctx);
+}
+
+constexpr std::uint8_t all = bit(encoding::path_segment)
+                             | bit(encoding::query_key)
+                             | bit(encoding::query_value)
+                             | bit(encoding::fragment)
+                             | bit(encoding::userinfo);
+
+// One bit per encoding, set if the octet can be left as it is.  These
+// are the sets of the rules in uri.cpp, without the UTF-8 they allow:
+// what we write is a URI, not an IRI.
+//
+//   unreserved  = ALPHA / DIGIT / "-" / "." / "_" / "~"
+//   sub-delims  = "!" / "$" / "&" / "'" / "(" / ")"
+//               / "*" / "+" / "," / ";" / "="
+//   pchar       = unreserved / pct-encoded / sub-delims / ":" / "@"
+//   query       = *( pchar / "/" / "?" )
+//   fragment    = *( pchar / "/" / "?" )
+//   userinfo    = *( unreserved / pct-encoded / sub-delims / ":" )
+//
+// A query key loses "&", "=" and "+", a query value "&" and "+", so
+// that query_view splits and decodes them back to what they were.
+
+constexpr std::array<std::uint8_t, 256> make_safe()
+{
+  std::array<std::uint8_t, 256> safe{};
+
+  for (auto c = '0'; c <= '9'; ++c)
+    safe[c] = all;
+  for (auto c = 'A'; c <= 'Z'; ++c)
+    safe[c] = all;
+  for (auto c = 'a'; c <= 'z'; ++c)
+    safe[c] = all;
+  for (auto c : {'-', '.', '_', '~'})
+    safe[c] = all;
+
+  for (auto c : {'!', '$', '\'', '(', ')', '*', ',', ';'})
+    safe[c] = all;
+  safe['&'] = all & ~(bit(encoding::query_key) | bit(encoding::query_value));
+  safe['+'] = all & ~(bit(encoding::query_key) | bit(encoding::query_value));
+  safe['='] = all & ~bit(encoding::query_key);
+
+  safe[':'] = all;
+  safe['@'] = all & ~bit(encoding::userinfo);
+
+  for (auto c : {'/', '?'}) {
+    safe[c] = bit(encoding::query_key) | bit(encoding::query_value)
+              | bit(encoding::fragment);
+  }
+
+  return safe;
+}
+
+constexpr auto safe = make_safe();
+
+constexpr char hex_digits[] = "0123456789ABCDEF";
+
+bool is_safe(char ch, std::uint8_t mask)
+{
+  return safe[static_cast<unsigned char>(ch)] & mask;
+}
+
+constexpr std::array<std::int8_t, 256> make_hex()
+{
+  std::array<std::int8_t, 256> hex{};
+  for (auto i = 0; i < 256; ++i)
+    hex[i] = static_cast<std::int8_t>(uri::grammar::hex_value(i));
+  return hex;
+}
+
+constexpr auto hex = make_hex();
+
+int hex_value(char ch)
+{
+  return hex[static_cast<unsigned char>(ch)];
+}
+
+#ifdef __SSE2__
+// True if all 16 octets at p are ALPHA or DIGIT, safe in every context.
+bool alnum_16(char const* p)
+{
+  auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+
+  auto const in_range = [v](char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+  };
+
+  auto const ok = _mm_or_si128(_mm_or_si128(in_range('a', 'z'),
+                                            in_range('A', 'Z')),
+                               in_range('0', '9'));
+  return _mm_movemask_epi8(ok) == 0xFFFF;
+}
+#endif
+
+// Number of octets before the first "%" in [in, end).
+std::size_t run_length(char const* in, char const* end)
+{
+  auto const len = static_cast<std::size_t>(end - in);
+#ifdef __SSE2__
+  std::size_t i   = 0;
+  auto const  pct = _mm_set1_epi8('%');
+  for (; i + 16 <= len; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+    auto const m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pct));
+    if (m)
+      return i + __builtin_ctz(m);
+  }
+  for (; i < len; ++i) {
+    if (in[i] == '%')
+      return i;
+  }
+  return len;
+#else
+  auto const p = static_cast<char const*>(std::memchr(in, '%', len));
+  return p ? static_cast<std::size_t>(p - in) : len;
+#endif
+}
+
+// Works in place too: out never gets ahead of in.
+char* decode(char const* in, char const* end, char* out, uri::decoding mode)
+{
+  while (in < end) {
+    auto const n = run_length(in, end);
+    if (out != in)
+      std::memmove(out, in, n);
+    in += n;
+    out += n;
+    if (in == end)
+      break;
+
+    // *in == '%'
+    if ((end - in >= 3) && (hex_value(in[1]) >= 0)
+        && (hex_value(in[2]) >= 0)) {
+      *out++ = static_cast<char>(16 * hex_value(in[1]) + hex_value(in[2]));
+      in += 3;
+      continue;
+    }
+    if (mode == uri::decoding::strict)
+      return nullptr;
+    *out++ = *in++;
+  }
+  return out;
+}
+
+} // namespace
+
+namespace uri {
+
+DLL_PUBLIC std::size_t encoded_size(std::string_view raw,
+                                    encoding         ctx) noexcept
+{
+  auto const  mask = bit(ctx);
+  std::size_t size = raw.size();
+  std::size_t i    = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= raw.size(); i += 16) {
+    if (alnum_16(raw.data() + i))
+      continue;
+    for (auto j = i; j < i + 16; ++j) {
+      if (!is_safe(raw[j], mask))
+        size += 2;
+    }
+  }
+#endif
+  for (; i < raw.size(); ++i) {
+    if (!is_safe(raw[i], mask))
+      size += 2;
+  }
+  return size;
+}
+
+DLL_PUBLIC char*
+pct_encode(std::string_view raw, encoding ctx, char* out) noexcept
+{
+  auto const mask = bit(ctx);
+
+  auto const one = [mask, &out](char ch) {
+    if (is_safe(ch, mask)) {
+      *out++ = ch;
+    }
+    else {
+      auto const octet = static_cast<unsigned char>(ch);
+      *out++           = '%';
+      *out++           = hex_digits[octet >> 4];
+      *out++           = hex_digits[octet & 0xF];
+    }
+  };
+
+  std::size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= raw.size(); i += 16) {
+    if (alnum_16(raw.data() + i)) {
+      std::copy_n(raw.data() + i, 16, out);
+      out += 16;
+      continue;
+    }
+    for (auto j = i; j < i + 16; ++j)
+      one(raw[j]);
+  }
+#endif
+  for (; i < raw.size(); ++i)
+    one(raw[i]);
+
+  return out;
+}
+
+DLL_PUBLIC std::string pct_encode(std::string_view raw, encoding ctx)
+{
+  std::string out(encoded_size(raw, ctx), '\0');
+  pct_encode(raw, ctx, out.data());
+  return out;
+}
+
+DLL_PUBLIC char*
+pct_decode(std::string_view in, char* out, decoding mode) noexcept
+{
+  return decode(in.data(), in.data() + in.size(), out, mode);
+}
+
+DLL_PUBLIC std::string pct_decode(std::string_view in, decoding mode)
+{
+  std::string out(in.size(), '\0');
+  auto const  end = pct_decode(in, out.data(), mode);
+  if (!end)
+    throw syntax_error();
+  out.resize(end - out.data());
+  return out;
+}
+
+DLL_PUBLIC bool pct_decode_in_place(std::string& s, decoding mode) noexcept
+{
+  if (mode == decoding::strict) {
+    // Check first, so a failure leaves s as it was.
+    for (auto i = s.find('%'); i != std::string::npos;
+         i = s.find('%', i + 1)) {
+      if ((i + 2 >= s.size()) || (hex_value(s[i + 1]) < 0)
+          || (hex_value(s[i + 2]) < 0))
+        return false;
+    }
+  }
+  auto const end = decode(s.data(), s.data() + s.size(), s.data(), mode);
+  s.resize(end - s.data());
+  return true;
+}
+
+} // namespace uri
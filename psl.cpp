@@ -0,0 +1,207 @@
+#define BUILDING_DLL
+#include "psl.hpp"
+
+#include "label_trie.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <idn2.h>
+
+namespace {
+
+using uri_internal::next_label;
+
+// A rule's labels go in last first, so "co.uk" is "uk" then "co".
+struct builder_node {
+  std::map<std::string, std::unique_ptr<builder_node>, std::less<>> children;
+
+  std::uint8_t flags{0};
+};
+
+void add_rule(builder_node& root, std::string_view name, std::uint8_t flag)
+{
+  uri_internal::add_labels(root, name).flags |= flag;
+}
+
+bool is_ascii(std::string_view s)
+{
+  return std::all_of(begin(s), end(s),
+                     [](unsigned char c) { return c < 0x80; });
+}
+
+// The A-label form of a rule written with U-labels, as normalize_host()
+// would make it; nothing if IDNA will not have it.
+std::optional<std::string> to_ascii(std::string const& name)
+{
+  char*      ptr  = nullptr;
+  auto const code = idn2_to_ascii_8z(name.c_str(), &ptr, IDN2_TRANSITIONAL);
+  if (code != IDN2_OK)
+    return {};
+  std::string ascii = ptr;
+  idn2_free(ptr);
+  return ascii;
+}
+
+// The last n labels of host, if it has that many.
+std::optional<std::string_view> last_labels(std::string_view host,
+                                            std::size_t      n)
+{
+  auto start = host.size() + 1; // as if host ended with a "."
+  for (; n; --n) {
+    if (start == 0)
+      return {};
+    auto const dot = (start > 1) ? host.rfind('.', start - 2)
+                                 : std::string_view::npos;
+    start = (dot == std::string_view::npos) ? 0 : (dot + 1);
+  }
+  return host.substr(std::min(start, host.size()));
+}
+
+// The longest a label can be and still be compared: 63 octets of
+// A-label, or 63 code points of U-label.
+constexpr std::size_t max_label = 4 * 63;
+
+} // namespace
+
+namespace uri {
+
+public_suffix_list public_suffix_list::load(std::string const& path,
+                                            sections           which)
+{
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("can't open " + path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return parse(text.str(), which);
+}
+
+public_suffix_list public_suffix_list::parse(std::string_view text,
+                                             sections         which)
+{
+  public_suffix_list psl;
+  builder_node       root;
+
+  while (!text.empty()) {
+    auto const eol  = text.find('\n');
+    auto       line = text.substr(0, eol);
+    text = (eol == std::string_view::npos) ? std::string_view{}
+                                           : text.substr(eol + 1);
+
+    if (line.find("===BEGIN PRIVATE DOMAINS===") != std::string_view::npos) {
+      if (which == sections::icann)
+        break;
+      continue;
+    }
+
+    // A rule is the first run of non white space on its line.
+    auto const first = line.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos)
+      continue;
+    line = line.substr(first);
+    line = line.substr(0, line.find_first_of(" \t\r"));
+    if (line.substr(0, 2) == "//")
+      continue;
+
+    std::uint8_t flag = rule;
+    if (line.front() == '!') {
+      flag = exception;
+      line.remove_prefix(1);
+    }
+    else if (line.substr(0, 2) == "*.") {
+      flag = wildcard;
+      line.remove_prefix(2);
+    }
+    if (line.empty() || (line.find('*') != std::string_view::npos))
+      continue;
+
+    std::string name;
+    std::transform(begin(line), end(line), std::back_inserter(name),
+                   [](unsigned char c) { return std::tolower(c); });
+    add_rule(root, name, flag);
+    if (!is_ascii(name)) {
+      if (auto const ascii = to_ascii(name))
+        add_rule(root, *ascii, flag);
+    }
+    ++psl.size_;
+  }
+
+  // Breadth first, as router::builder::build() does it.
+  uri_internal::flatten(root, psl.nodes_, psl.labels_,
+                        [&psl](builder_node const& from, std::uint32_t index,
+                               auto const&) {
+                          psl.nodes_[index].flags = from.flags;
+                        });
+
+  return psl;
+}
+
+std::uint32_t public_suffix_list::child(node const&      parent,
+                                        std::string_view label) const
+{
+  return uri_internal::child(nodes_, labels_, parent, label);
+}
+
+public_suffix_list::domain
+public_suffix_list::find(std::string_view host) const noexcept
+{
+  if (!host.empty() && (host.back() == '.'))
+    host.remove_suffix(1);
+  if (host.empty() || nodes_.empty())
+    return {};
+
+  // The number of labels in the public suffix: one by the "*" rule,
+  // more by the longest rule that matches, fewer by an exception.
+  std::size_t suffix = 1;
+  std::size_t depth  = 0;
+  auto        n      = std::uint32_t{0};
+
+  auto             rest = host;
+  std::string_view label;
+  while (next_label(rest, label)) {
+    if (nodes_[n].flags & wildcard)
+      suffix = std::max(suffix, depth + 1);
+
+    if (label.size() > max_label)
+      break;
+    char lower[max_label];
+    std::transform(begin(label), end(label), lower,
+                   [](unsigned char c) { return std::tolower(c); });
+
+    auto const c = child(nodes_[n], std::string_view(lower, label.size()));
+    if (c == none)
+      break;
+    if (nodes_[c].flags & exception) {
+      suffix = depth;
+      break;
+    }
+    if (nodes_[c].flags & rule)
+      suffix = std::max(suffix, depth + 1);
+    n = c;
+    ++depth;
+  }
+
+  auto const public_suffix = last_labels(host, suffix);
+  if (!public_suffix)
+    return {}; // not reached: rules match whole labels of host
+  return {*public_suffix, last_labels(host, suffix + 1).value_or("")};
+}
+
+public_suffix_list::domain public_suffix_list::find(uri const& u) const
+    noexcept
+{
+  auto const& parts = u.parts();
+  if (!parts.host || (parts.host_type == host_kind::IPv4)
+      || (parts.host_type == host_kind::IPv6)
+      || (parts.host_type == host_kind::IPvFuture))
+    return {};
+  return find(*parts.host);
+}
+
+} // namespace uri
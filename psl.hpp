@@ -0,0 +1,85 @@
+#ifndef PSL_HPP_INCLUDED
+#define PSL_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The public suffix and registrable domain (eTLD+1) of a host, from
+// the Public Suffix List, <https://publicsuffix.org/list/>.
+//
+// The rules are loaded from a local copy of public_suffix_list.dat into
+// a trie on their labels, last label first, flattened the same way as
+// a router's: each node's children next to one another in name order.
+// Rules in the file are written as U-labels; each goes in as its
+// A-label form too, so hosts match in either form.  A lookup makes no
+// allocations; the results point into the host.
+//
+//   auto const psl = uri::public_suffix_list::load("public_suffix_list.dat");
+//   auto const d = psl.find(uri::generic{"https://www.example.co.uk/", true});
+//   // d.public_suffix == "co.uk", d.registrable_domain == "example.co.uk"
+
+namespace uri {
+
+class DLL_PUBLIC public_suffix_list {
+public:
+  // Which part of the list to use.
+  enum class sections : bool {
+    icann, // just the ICANN domains
+    all,   // and the private ones, such as blogspot.com
+  };
+
+  struct domain {
+    std::string_view public_suffix;      // empty for no host, or an IP
+    std::string_view registrable_domain; // empty if host is a suffix
+  };
+
+  // Throws std::runtime_error if path can't be read.
+  static public_suffix_list load(std::string const& path,
+                                 sections           which = sections::all);
+
+  // The same from the text of a list.
+  static public_suffix_list parse(std::string_view text,
+                                  sections         which = sections::all);
+
+  // host is a reg-name, lower case as normalize() leaves it.  A host
+  // no rule matches has its last label as its public suffix, as the
+  // list's "*" rule has it.
+  domain find(std::string_view host) const noexcept;
+
+  // Nothing for IP literals and IPv4 addresses.  The result points into
+  // u, so u must outlive it.
+  domain find(uri const& u) const noexcept;
+
+  std::size_t size() const { return size_; } // number of rules
+
+private:
+  static constexpr std::uint32_t none = ~std::uint32_t{0};
+
+  enum flag : std::uint8_t {
+    rule      = 1 << 0, // a rule ends here
+    wildcard  = 1 << 1, // "*." and this
+    exception = 1 << 2, // "!" and this
+  };
+
+  struct node {
+    std::uint32_t label{0}; // offset into labels_
+    std::uint32_t label_size{0};
+    std::uint32_t children{0}; // index of the first in nodes_
+    std::uint32_t n_children{0};
+    std::uint8_t  flags{0};
+  };
+
+  std::uint32_t child(node const& parent, std::string_view label) const;
+
+  std::vector<node> nodes_; // nodes_[0] is the root
+  std::string       labels_;
+  std::size_t       size_{0};
+};
+
+} // namespace uri
+
+#endif // PSL_HPP_INCLUDED
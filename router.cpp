@@ -0,0 +1,190 @@
+#define BUILDING_DLL
+#include "router.hpp"
+
+#include "label_trie.hpp"
+
+#include <thread>
+#include <utility>
+
+namespace {
+
+using uri_internal::next_label;
+
+// Path segments come off the front, with the leading "/" ignored.
+bool next_segment(std::string_view& path, std::string_view& segment)
+{
+  if (path.empty())
+    return false;
+  auto const slash = path.find('/');
+  if (slash == std::string_view::npos) {
+    segment = path;
+    path    = {};
+  }
+  else {
+    segment = path.substr(0, slash);
+    path    = path.substr(slash + 1);
+  }
+  return true;
+}
+
+std::string_view trim_path(std::string_view path)
+{
+  if (!path.empty() && (path.front() == '/'))
+    path.remove_prefix(1);
+  if (!path.empty() && (path.back() == '/'))
+    path.remove_suffix(1);
+  return path;
+}
+
+// The most labels a host of 253 octets can have.
+constexpr std::size_t max_labels = 127;
+
+} // namespace
+
+namespace uri {
+
+void router::builder::add(std::string_view host,
+                          std::string_view path,
+                          std::uint32_t    value,
+                          hosts            which)
+{
+  auto  n     = &uri_internal::add_labels(root_, host);
+  auto& paths = (which == hosts::exact) ? n->exact : n->subdomains;
+  if (!paths)
+    paths = std::make_unique<node>();
+  n = paths.get();
+
+  path = trim_path(path);
+  std::string_view segment;
+  while (next_segment(path, segment)) {
+    auto& child = n->children[std::string(segment)];
+    if (!child)
+      child = std::make_unique<node>();
+    n = child.get();
+  }
+
+  if (!n->value)
+    ++size_;
+  n->value = value;
+}
+
+void router::builder::add(uri const& rule, std::uint32_t value, hosts which)
+{
+  auto const& parts = rule.parts();
+  add(parts.host ? *parts.host : std::string_view{},
+      parts.path ? *parts.path : std::string_view{}, value, which);
+}
+
+// Breadth first, so each node's children land next to one another.
+router router::builder::build() const
+{
+  router r;
+  r.size_ = size_;
+
+  uri_internal::flatten(
+      root_, r.nodes_, r.labels_,
+      [&r](node const& from, std::uint32_t index, auto const& place) {
+        if (from.value)
+          r.nodes_[index].value = *from.value;
+        // place() may have moved the nodes, so no holding on to one.
+        if (from.exact) {
+          auto const i          = place(from.exact.get());
+          r.nodes_[index].exact = i;
+        }
+        if (from.subdomains) {
+          auto const i               = place(from.subdomains.get());
+          r.nodes_[index].subdomains = i;
+        }
+      });
+
+  return r;
+}
+
+std::uint32_t router::child(node const& parent, std::string_view label) const
+{
+  return uri_internal::child(nodes_, labels_, parent, label);
+}
+
+std::uint32_t router::match_path(std::uint32_t root, std::string_view path) const
+{
+  auto best = nodes_[root].value;
+  auto n    = root;
+
+  if (!path.empty() && (path.front() == '/'))
+    path.remove_prefix(1);
+  std::string_view segment;
+  while (next_segment(path, segment)) {
+    n = child(nodes_[n], segment);
+    if (n == none)
+      break;
+    if (nodes_[n].value != none)
+      best = nodes_[n].value;
+  }
+  return best;
+}
+
+std::optional<std::uint32_t> router::find(std::string_view host,
+                                          std::string_view path) const noexcept
+{
+  if (nodes_.empty())
+    return {};
+
+  // The roots of the path tries that apply, least specific host first.
+  std::uint32_t roots[2 * max_labels + 2];
+  std::size_t   n_roots = 0;
+
+  auto n = std::uint32_t{0};
+  if (nodes_[n].subdomains != none)
+    roots[n_roots++] = nodes_[n].subdomains;
+
+  std::string_view label;
+  auto             labels = std::size_t{0};
+  while (next_label(host, label)) {
+    if (++labels > max_labels)
+      return {};
+    n = child(nodes_[n], label);
+    if (n == none)
+      break;
+    if (nodes_[n].subdomains != none)
+      roots[n_roots++] = nodes_[n].subdomains;
+  }
+  if ((n != none) && (nodes_[n].exact != none))
+    roots[n_roots++] = nodes_[n].exact;
+
+  while (n_roots) {
+    auto const value = match_path(roots[--n_roots], path);
+    if (value != none)
+      return value;
+  }
+  return {};
+}
+
+std::optional<std::uint32_t> router::find(uri const& u) const noexcept
+{
+  auto const& parts = u.parts();
+  return find(parts.host ? *parts.host : std::string_view{},
+              parts.path ? *parts.path : std::string_view{});
+}
+
+router_holder::router_holder()
+  : current_(new router)
+{
+}
+
+router_holder::~router_holder() { delete current_.load(); }
+
+void router_holder::swap_in(router r)
+{
+  auto fresh = std::make_unique<router const>(std::move(r));
+
+  std::lock_guard<std::mutex> lock(writer_);
+  std::unique_ptr<router const> old(current_.exchange(fresh.release()));
+
+  // Readers from now on are counted in the other slot, and see the new
+  // router; those in this one may have the old.
+  auto const epoch = epoch_.fetch_add(1);
+  while (readers_[epoch & 1].load(std::memory_order_acquire) != 0)
+    std::this_thread::yield();
+}
+
+} // namespace uri
@@ -0,0 +1,174 @@
+#ifndef ROUTER_HPP_INCLUDED
+#define ROUTER_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Matches URIs against a large set of rules, each a host and a path
+// prefix with a value: allow or deny, a route, whatever the caller
+// numbers them.
+//
+// Hosts are a trie on their labels, last label first; each host has a
+// trie of path segments below it.  A built router is two flat arrays,
+// one of nodes and one of label text, with each node's children next
+// to one another in name order, so finding a child is a binary search
+// of one short run of nodes.  A lookup makes no allocations.
+//
+// Rules and lookups should both use normalized URIs: hosts and paths
+// are compared octet for octet.
+//
+//   uri::router::builder b;
+//   b.add(uri::generic{"http://example.com/api", true}, 1);
+//   b.add(uri::generic{"http://ads.example/", true}, 2,
+//         uri::router::hosts::subdomains);
+//   auto const r = b.build();
+//   auto const value = r.find(uri::generic{"http://example.com/api/v2"});
+
+namespace uri {
+
+class DLL_PUBLIC router {
+public:
+  // Which hosts a rule applies to.
+  enum class hosts : bool {
+    exact,      // just its own
+    subdomains, // its own and all those under it
+  };
+
+  class DLL_PUBLIC builder {
+  public:
+    // A later rule for the same host, path and hosts replaces an earlier
+    // one.  A path prefix matches whole segments: "/a/b" matches "/a/b"
+    // and "/a/b/c" but not "/a/bc".  An empty path, or "/", matches all.
+    void add(std::string_view host,
+             std::string_view path,
+             std::uint32_t    value,
+             hosts            which = hosts::exact);
+    void add(uri const& rule, std::uint32_t value, hosts which = hosts::exact);
+
+    router build() const;
+
+  private:
+    struct node {
+      std::map<std::string, std::unique_ptr<node>, std::less<>> children;
+
+      std::optional<std::uint32_t> value;      // path nodes
+      std::unique_ptr<node>        exact;      // host nodes: path tries
+      std::unique_ptr<node>        subdomains; //
+    };
+
+    node          root_;
+    std::uint32_t size_{0};
+  };
+
+  router() = default;
+
+  // The value of the rule with the most specific host that has a path
+  // prefix matching, and of those the longest prefix.
+  std::optional<std::uint32_t> find(std::string_view host,
+                                    std::string_view path) const noexcept;
+  std::optional<std::uint32_t> find(uri const& u) const noexcept;
+
+  std::uint32_t size() const { return size_; } // number of rules
+
+private:
+  static constexpr std::uint32_t none = ~std::uint32_t{0};
+
+  struct node {
+    std::uint32_t label{0}; // offset into labels_
+    std::uint32_t label_size{0};
+    std::uint32_t children{0}; // index of the first in nodes_
+    std::uint32_t n_children{0};
+    std::uint32_t value{none};      // path nodes
+    std::uint32_t exact{none};      // host nodes: roots of path tries
+    std::uint32_t subdomains{none}; //
+  };
+
+  std::uint32_t child(node const& parent, std::string_view label) const;
+  std::uint32_t match_path(std::uint32_t root, std::string_view path) const;
+
+  std::vector<node> nodes_; // nodes_[0] is the root of the host trie
+  std::string       labels_;
+  std::uint32_t     size_{0};
+};
+
+// Holds the current router for readers on any number of threads while
+// a writer builds a new one and swaps it in.  Readers take no lock: each
+// is counted in one of two slots, picked by an epoch that swap_in()
+// advances, and swap_in() frees the router it replaced once the readers
+// counted before the change have gone.  So keep a reader only as long
+// as a lookup takes, and never call swap_in() while holding one.
+class DLL_PUBLIC router_holder {
+public:
+  // The router that was current when it was made, until it goes.
+  class reader {
+  public:
+    explicit reader(router_holder const& holder) noexcept;
+    reader(reader&& rhs) noexcept
+      : slot_(rhs.slot_)
+      , router_(rhs.router_)
+    {
+      rhs.slot_ = nullptr;
+    }
+    ~reader()
+    {
+      if (slot_)
+        slot_->fetch_sub(1, std::memory_order_release);
+    }
+
+    reader(reader const&) = delete;
+    reader& operator=(reader const&) = delete;
+    reader& operator=(reader&&) = delete;
+
+    router const& operator*() const { return *router_; }
+    router const* operator->() const { return router_; }
+
+  private:
+    std::atomic<unsigned>* slot_;
+    router const*          router_;
+  };
+
+  router_holder();
+  ~router_holder();
+
+  router_holder(router_holder const&) = delete;
+  router_holder& operator=(router_holder const&) = delete;
+
+  reader get() const noexcept { return reader(*this); }
+
+  // Waits for readers of the router it replaces.
+  void swap_in(router r);
+
+private:
+  std::atomic<router const*>    current_;
+  mutable std::atomic<unsigned> readers_[2]{}; // by parity of epoch_
+  std::atomic<unsigned>         epoch_{0};
+  std::mutex                    writer_; // one swap_in() at a time
+};
+
+inline router_holder::reader::reader(router_holder const& holder) noexcept
+{
+  // Counted under the epoch that was current after the count went up,
+  // so a swap_in() either waits for this reader or swapped first.
+  for (;;) {
+    auto const epoch = holder.epoch_.load();
+    slot_            = &holder.readers_[epoch & 1];
+    slot_->fetch_add(1);
+    if (holder.epoch_.load() == epoch)
+      break;
+    slot_->fetch_sub(1, std::memory_order_release);
+  }
+  router_ = holder.current_.load();
+}
+
+} // namespace uri
+
+#endif // ROUTER_HPP_INCLUDED
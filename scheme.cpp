@@ -0,0 +1,305 @@
+#define BUILDING_DLL
+#include "uri.hpp"
+
+#include "fnv1a.hpp"
+
+#include <array>
+#include <atomic>
+#include <forward_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace {
+
+using uri::scheme_info;
+
+// A hand-picked subset, about a hundred of the near three hundred
+// schemes in <https://www.iana.org/assignments/uri-schemes/uri-schemes.xhtml>:
+// the WHATWG special schemes, most permanent schemes of IETF protocols,
+// and a few provisional or historical schemes of network services that
+// have a well-known port (git, redis, ssh, svn, ...).  Most of the rest
+// are vendor and application schemes, and some common ones are missing
+// too: irc, bitcoin, webcal, spotify and steam among them.
+// register_scheme() adds any a program cares about.
+//
+// The IANA registry says nothing about ports, so a scheme gets a
+// default port only where its defining document names one.  Many of
+// the schemes have no authority and are here just for their flags.
+
+constexpr auto P = scheme_info::permanent;
+constexpr auto V = scheme_info::provisional;
+constexpr auto H = scheme_info::historical;
+constexpr auto S = scheme_info::special;
+
+// clang-format off
+constexpr scheme_info builtin[] = {
+  // https://url.spec.whatwg.org/#url-miscellaneous
+  {"ftp",             "",    21, P | S},
+  {"gopher",          "",    70, P | S},
+  {"http",            "/",   80, P | S},
+  {"https",           "/",  443, P | S},
+  {"ws",              "",    80, P | S},
+  {"wss",             "",   443, P | S},
+  {"file",            "",     0, P | S},
+
+  {"aaa",             "",  3868, P},
+  {"aaas",            "",  5658, P},
+  {"about",           "",     0, P},
+  {"acap",            "",   674, P},
+  {"acct",            "",     0, P},
+  {"amqp",            "",  5672, V},
+  {"blob",            "",     0, V},
+  {"cap",             "",  1026, P},
+  {"cid",             "",     0, P},
+  {"coap",            "",  5683, P},
+  {"coap+tcp",        "",  5683, P},
+  {"coap+ws",         "",    80, P},
+  {"coaps",           "",  5684, P},
+  {"coaps+tcp",       "",  5684, P},
+  {"coaps+ws",        "",   443, P},
+  {"crid",            "",     0, P},
+  {"data",            "",     0, P},
+  {"dav",             "",     0, P},
+  {"dict",            "",  2628, V},
+  {"dns",             "",    53, P},
+  {"example",         "",     0, P},
+  {"geo",             "",     0, P},
+  {"git",             "",  9418, V},
+  {"go",              "",  1096, P},
+  {"h323",            "",  1720, P},
+  {"iax",             "",  4569, P},
+  {"icap",            "",  1344, P},
+  {"im",              "",     0, P},
+  {"imap",            "",   143, P},
+  {"info",            "",     0, P},
+  {"ipp",             "",   631, P},
+  {"ipps",            "",   631, P},
+  {"iris",            "",     0, P},
+  {"iris.beep",       "",   702, P},
+  {"iris.lwz",        "",   715, P},
+  {"iris.xpc",        "",   713, P},
+  {"iris.xpcs",       "",   714, P},
+  {"jabber",          "",     0, V},
+  {"ldap",            "",   389, P},
+  {"magnet",          "",     0, V},
+  {"mailserver",      "",     0, H},
+  {"mailto",          "",     0, P},
+  {"mid",             "",     0, P},
+  {"modem",           "",     0, H},
+  {"msrp",            "",     0, P},
+  {"msrps",           "",     0, P},
+  {"mtqp",            "",  1038, P},
+  {"mupdate",         "",  3905, P},
+  {"news",            "",   119, P},
+  {"nfs",             "",  2049, P},
+  {"ni",              "",     0, P},
+  {"nih",             "",     0, P},
+  {"nntp",            "",   119, P},
+  {"opaquelocktoken", "",     0, P},
+  {"pkcs11",          "",     0, P},
+  {"pop",             "",   110, P},
+  {"pres",            "",     0, P},
+  {"prospero",        "",  1525, H},
+  {"redis",           "",  6379, V},
+  {"rediss",          "",  6379, V},
+  {"rsync",           "",   873, V},
+  {"rtmp",            "",  1935, V},
+  {"rtsp",            "",   554, P},
+  {"rtsps",           "",   322, P},
+  {"rtspu",           "",   554, P},
+  {"service",         "",     0, P},
+  {"session",         "",     0, P},
+  {"sftp",            "",    22, V},
+  {"sieve",           "",  4190, P},
+  {"sip",             "",  5060, P},
+  {"sips",            "",  5061, P},
+  {"smb",             "",   445, V},
+  {"sms",             "",     0, P},
+  {"snmp",            "",   161, P},
+  {"soap.beep",       "",   605, P},
+  {"soap.beeps",      "",   605, P},
+  {"ssh",             "",    22, V},
+  {"stun",            "",  3478, P},
+  {"stuns",           "",  5349, P},
+  {"svn",             "",  3690, V},
+  {"tag",             "",     0, P},
+  {"tel",             "",     0, P},
+  {"telnet",          "",    23, P},
+  {"tftp",            "",    69, P},
+  {"thismessage",     "",     0, P},
+  {"tip",             "",  3372, P},
+  {"tn3270",          "",    23, P},
+  {"turn",            "",  3478, P},
+  {"turns",           "",  5349, P},
+  {"tv",              "",     0, P},
+  {"urn",             "",     0, P},
+  {"vemmi",           "",   575, P},
+  {"vnc",             "",  5900, P},
+  {"wais",            "",   210, H},
+  {"xcon",            "",     0, P},
+  {"xcon-userid",     "",     0, P},
+  {"xmlrpc.beep",     "",   602, P},
+  {"xmlrpc.beeps",    "",   602, P},
+  {"xmpp",            "",     0, P},
+  {"z39.50r",         "",   210, P},
+  {"z39.50s",         "",   210, P},
+};
+// clang-format on
+
+constexpr auto n_builtin = sizeof(builtin) / sizeof(builtin[0]);
+
+static_assert(n_builtin < 0xFF, "index entries are one byte");
+
+constexpr unsigned char lower(unsigned char c)
+{
+  return (('A' <= c) && (c <= 'Z')) ? (c | 0x20) : c;
+}
+
+// FNV-1a over the lower cased name, plus a final mix so the low bits
+// depend on every byte.
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed)
+{
+  auto h = uri_internal::fnv1a(name, seed, lower);
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  return h;
+}
+
+constexpr std::size_t index_size = 1024; // a power of two
+constexpr std::uint8_t no_slot    = 0xFF;
+
+using index_t = std::array<std::uint8_t, index_size>;
+
+// Fills in idx and returns true if seed gives no collisions.
+constexpr bool try_seed(std::uint32_t seed, index_t& idx)
+{
+  for (auto& i : idx)
+    i = no_slot;
+  for (std::size_t n = 0; n < n_builtin; ++n) {
+    auto& slot = idx[hash(builtin[n].name, seed) & (index_size - 1)];
+    if (slot != no_slot)
+      return false;
+    slot = static_cast<std::uint8_t>(n);
+  }
+  return true;
+}
+
+constexpr std::uint32_t find_seed()
+{
+  index_t idx{};
+  for (std::uint32_t seed = 0;; ++seed) {
+    if (try_seed(seed, idx))
+      return seed;
+  }
+}
+
+constexpr auto seed = find_seed();
+
+constexpr index_t make_index()
+{
+  index_t idx{};
+  try_seed(seed, idx);
+  return idx;
+}
+
+constexpr index_t slot_index = make_index();
+
+// The name has already matched on the hash; this is the one check that
+// it is not some other string landing in the same slot.
+bool same_name(std::string_view lc_name, std::string_view name)
+{
+  if (lc_name.size() != name.size())
+    return false;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (lc_name[i] != lower(static_cast<unsigned char>(name[i])))
+      return false;
+  }
+  return true;
+}
+
+// Schemes added at run time.  Each registration builds a new immutable
+// table and publishes it with a single atomic store, so readers never
+// take a lock.  Old tables are kept, never freed, in case some reader
+// is still looking at one.
+
+struct extra_table {
+  std::vector<scheme_info>  entries;
+  std::vector<std::int32_t> slots; // size is a power of two, -1 is empty
+};
+
+std::atomic<extra_table const*> extras{nullptr};
+
+std::mutex                                      extras_mutex;
+std::forward_list<std::string>                  extras_names;
+std::vector<std::unique_ptr<extra_table const>> extras_tables;
+
+scheme_info const* find_extra(extra_table const* tbl, std::string_view name)
+{
+  auto const mask = tbl->slots.size() - 1;
+  for (auto i = hash(name, 0) & mask;; i = (i + 1) & mask) {
+    auto const slot = tbl->slots[i];
+    if (slot < 0)
+      return nullptr;
+    if (same_name(tbl->entries[slot].name, name))
+      return &tbl->entries[slot];
+  }
+}
+
+} // namespace
+
+namespace uri {
+
+DLL_PUBLIC scheme_info const* find_scheme(std::string_view name)
+{
+  if (auto const tbl = extras.load(std::memory_order_acquire)) {
+    if (auto const info = find_extra(tbl, name))
+      return info;
+  }
+  auto const slot = slot_index[hash(name, seed) & (index_size - 1)];
+  if ((slot != no_slot) && same_name(builtin[slot].name, name))
+    return &builtin[slot];
+  return nullptr;
+}
+
+DLL_PUBLIC void register_scheme(scheme_info const& info)
+{
+  std::lock_guard<std::mutex> lock(extras_mutex);
+
+  auto tbl = std::make_unique<extra_table>();
+  if (auto const old = extras.load(std::memory_order_relaxed)) {
+    for (auto const& e : old->entries) {
+      if (!same_name(e.name, info.name))
+        tbl->entries.push_back(e);
+    }
+  }
+
+  // Keep our own lower case copy of the strings.
+  extras_names.emplace_front(info.name);
+  auto& name = extras_names.front();
+  for (auto& c : name)
+    c = lower(static_cast<unsigned char>(c));
+  extras_names.emplace_front(info.default_path);
+  auto const& path = extras_names.front();
+
+  tbl->entries.push_back({name, path, info.default_port, info.flags});
+
+  std::size_t size = 8;
+  while (size < 2 * tbl->entries.size())
+    size *= 2;
+  tbl->slots.assign(size, -1);
+  for (std::size_t n = 0; n < tbl->entries.size(); ++n) {
+    auto i = hash(tbl->entries[n].name, 0) & (size - 1);
+    while (tbl->slots[i] >= 0)
+      i = (i + 1) & (size - 1);
+    tbl->slots[i] = static_cast<std::int32_t>(n);
+  }
+
+  extras.store(tbl.get(), std::memory_order_release);
+  extras_tables.push_back(std::move(tbl));
+}
+
+} // namespace uri
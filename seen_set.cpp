@@ -0,0 +1,433 @@
+#define BUILDING_DLL
+#include "seen_set.hpp"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t   slots_per_bucket = 4;
+constexpr double        max_load         = 0.95;
+constexpr int           max_kicks        = 500;
+constexpr std::size_t   n_stripes        = 1024;
+constexpr std::size_t   batch            = 16;
+constexpr char          magic[8]         = {'U', 'R', 'I', 'S', 'E', 'E', 'N', '2'};
+constexpr std::uint64_t max_buckets      = std::uint64_t{1} << 32;
+
+// Slots hold fingerprints, zero meaning empty.  A fingerprint goes in
+// one of two buckets: the one its hash picks, or that one xor a hash of
+// the fingerprint, so that either bucket can be found from the other.
+// The bucket comes from h1 of the URI's uri::fingerprint, the slot's
+// fingerprint from h2.
+template <typename Slot>
+struct table {
+  static_assert(sizeof(std::atomic<Slot>) == sizeof(Slot));
+
+  explicit table(std::uint64_t n_buckets)
+    : mask(n_buckets - 1)
+    , slots(n_buckets * slots_per_bucket)
+  {
+  }
+
+  static Slot fingerprint(uri::fingerprint const& h)
+  {
+    auto const f = static_cast<Slot>(h.h2);
+    return f ? f : 1;
+  }
+
+  std::uint64_t index(uri::fingerprint const& h) const { return h.h1 & mask; }
+
+  std::uint64_t alt(std::uint64_t i, Slot f) const
+  {
+    return (i ^ (std::uint64_t{f} * 0x5bd1e995)) & mask;
+  }
+
+  std::atomic<Slot>* bucket(std::uint64_t i)
+  {
+    return slots.data() + i * slots_per_bucket;
+  }
+  std::atomic<Slot> const* bucket(std::uint64_t i) const
+  {
+    return slots.data() + i * slots_per_bucket;
+  }
+
+  bool has(std::uint64_t i, Slot f) const
+  {
+    auto const b = bucket(i);
+    for (std::size_t s = 0; s < slots_per_bucket; ++s) {
+      if (b[s].load(std::memory_order_acquire) == f)
+        return true;
+    }
+    return false;
+  }
+
+  bool put(std::uint64_t i, Slot f)
+  {
+    auto const b = bucket(i);
+    for (std::size_t s = 0; s < slots_per_bucket; ++s) {
+      Slot empty = 0;
+      if (b[s].compare_exchange_strong(empty, f, std::memory_order_release))
+        return true;
+    }
+    return false;
+  }
+
+  void prefetch(uri::fingerprint const& h) const
+  {
+    auto const i = index(h);
+    __builtin_prefetch(bucket(i));
+    __builtin_prefetch(bucket(alt(i, fingerprint(h))));
+  }
+
+  char*       data() { return reinterpret_cast<char*>(slots.data()); }
+  char const* data() const { return reinterpret_cast<char const*>(slots.data()); }
+  std::size_t bytes() const { return slots.size() * sizeof(Slot); }
+
+  std::uint64_t                  mask;
+  std::vector<std::atomic<Slot>> slots;
+};
+
+using any_table = std::variant<table<std::uint8_t>,
+                               table<std::uint16_t>,
+                               table<std::uint32_t>>;
+
+any_table make_table(int bits, std::uint64_t n_buckets)
+{
+  switch (bits) {
+  case 8: return any_table(std::in_place_index<0>, n_buckets);
+  case 16: return any_table(std::in_place_index<1>, n_buckets);
+  case 32: return any_table(std::in_place_index<2>, n_buckets);
+  }
+  throw std::runtime_error("bad seen_set fingerprint size");
+}
+
+// With b slots a bucket, a lookup compares 2b fingerprints of f bits, so
+// a false positive rate of about 2b / 2^f.
+int fingerprint_bits(double false_positive_rate)
+{
+  if (!(false_positive_rate > 0) || !(false_positive_rate < 1))
+    throw std::invalid_argument("false_positive_rate must be in (0, 1)");
+  auto const bits = std::log2(2 * slots_per_bucket / false_positive_rate);
+  return (bits <= 8) ? 8 : (bits <= 16) ? 16 : 32;
+}
+
+std::uint64_t buckets_for(std::uint64_t capacity)
+{
+  auto const needed = static_cast<std::uint64_t>(
+      std::ceil(capacity / (slots_per_bucket * max_load)));
+  std::uint64_t n = 1;
+  while (n < needed)
+    n <<= 1;
+  if (n > max_buckets)
+    throw std::length_error("seen_set capacity too large");
+  return n;
+}
+
+} // namespace
+
+namespace uri {
+
+struct seen_set::impl {
+  impl(int bits_in, std::uint64_t n_buckets_in)
+    : bits(bits_in)
+    , n_buckets(n_buckets_in)
+    , table(make_table(bits_in, n_buckets_in))
+  {
+  }
+
+  bool insert(fingerprint const& h);
+  bool contains(fingerprint const& h) const;
+
+  // The version kicks leave, waiting out one in progress.
+  std::uint64_t stable_version() const
+  {
+    for (;;) {
+      auto const v = version.load(std::memory_order_acquire);
+      if (!(v & 1))
+        return v;
+      std::this_thread::yield();
+    }
+  }
+
+  // True if no kick started since stable_version() returned v, so
+  // that what was read in between is to be believed.  Slots are read
+  // with acquire, so this load can't move ahead of them, and a kick
+  // writes them with release, after making version odd.
+  bool unchanged(std::uint64_t v) const
+  {
+    return version.load(std::memory_order_acquire) == v;
+  }
+
+  int           bits;
+  std::uint64_t n_buckets;
+  any_table     table;
+
+  std::atomic<std::uint64_t> size{0};
+
+  // Odd while fingerprints are being moved from bucket to bucket, when
+  // one is in none of them.  Lookups take no lock: they read the slots
+  // and start over if this moved while they did.
+  std::atomic<std::uint64_t> version{0};
+
+  // One kick at a time, and none while saving.
+  mutable std::mutex kick_mutex;
+
+  // Set by save(), which inserts that see it wait out.
+  std::atomic<bool> saving{false};
+
+  // Inserts lock the stripes of both of their buckets, so that two of
+  // the same fingerprint can't go in at once.  Taken after kick_mutex.
+  mutable std::array<std::mutex, n_stripes> stripes;
+};
+
+namespace {
+
+// Runs f when it goes, however that is.
+template <typename F>
+struct at_exit {
+  F f;
+  ~at_exit() { f(); }
+};
+template <typename F>
+at_exit(F) -> at_exit<F>;
+
+// Locks the stripes of buckets i1 and i2, in order.
+class stripe_lock {
+public:
+  template <typename Stripes>
+  stripe_lock(Stripes& stripes, std::uint64_t i1, std::uint64_t i2)
+  {
+    auto const s1 = std::min(i1 % n_stripes, i2 % n_stripes);
+    auto const s2 = std::max(i1 % n_stripes, i2 % n_stripes);
+    lock1_        = std::unique_lock<std::mutex>(stripes[s1]);
+    if (s2 != s1)
+      lock2_ = std::unique_lock<std::mutex>(stripes[s2]);
+  }
+
+private:
+  std::unique_lock<std::mutex> lock1_;
+  std::unique_lock<std::mutex> lock2_;
+};
+
+} // namespace
+
+bool seen_set::impl::insert(fingerprint const& h)
+{
+  return std::visit(
+      [this, &h](auto& t) {
+        auto const f  = t.fingerprint(h);
+        auto const i1 = t.index(h);
+        auto const i2 = t.alt(i1, f);
+
+        for (;;) {
+          auto const  v = stable_version();
+          stripe_lock lock(stripes, i1, i2);
+
+          if (t.has(i1, f) || t.has(i2, f))
+            return false;
+          if (!unchanged(v))
+            continue; // a kick may have had it in hand
+          if (saving) {
+            std::this_thread::yield();
+            continue;
+          }
+          if (t.put(i1, f) || t.put(i2, f)) {
+            size.fetch_add(1, std::memory_order_relaxed);
+            return true;
+          }
+          break;
+        }
+
+        // Both buckets full: make room by moving others along.  Inserts
+        // and lookups that overlap this go round again.
+        std::lock_guard<std::mutex> kick(kick_mutex);
+        stripe_lock                 lock(stripes, i1, i2);
+
+        if (t.has(i1, f) || t.has(i2, f))
+          return false;
+        if (t.put(i1, f) || t.put(i2, f)) {
+          size.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+
+        version.fetch_add(1, std::memory_order_relaxed);
+        at_exit even{[this] {
+          version.fetch_add(1, std::memory_order_release);
+        }};
+
+        // Remember the moves, to undo them if we run out.
+        std::array<std::pair<std::uint64_t, std::size_t>, max_kicks> moves;
+
+        auto const r      = h.h1 >> 32; // bits index() doesn't use
+        auto       victim = f;
+        auto       i      = (r & 1) ? i1 : i2;
+        for (auto kick = 0; kick < max_kicks; ++kick) {
+          auto const s = (r >> (kick % 32)) % slots_per_bucket;
+          auto&      slot = t.bucket(i)[s];
+          victim = slot.exchange(victim, std::memory_order_acq_rel);
+          moves[kick] = {i, s};
+
+          i = t.alt(i, victim);
+          if (t.put(i, victim)) {
+            size.fetch_add(1, std::memory_order_relaxed);
+            return true;
+          }
+        }
+        for (auto kick = max_kicks; kick-- > 0;) {
+          auto const [b, s] = moves[kick];
+          victim = t.bucket(b)[s].exchange(victim, std::memory_order_acq_rel);
+        }
+        throw std::length_error("seen_set full");
+      },
+      table);
+}
+
+bool seen_set::impl::contains(fingerprint const& h) const
+{
+  return std::visit(
+      [this, &h](auto const& t) {
+        auto const f  = t.fingerprint(h);
+        auto const i1 = t.index(h);
+        auto const i2 = t.alt(i1, f);
+        for (;;) {
+          auto const v = stable_version();
+          if (t.has(i1, f) || t.has(i2, f))
+            return true;
+          if (unchanged(v))
+            return false;
+        }
+      },
+      table);
+}
+
+seen_set::seen_set(std::uint64_t capacity, double false_positive_rate)
+  : impl_(std::make_unique<impl>(::fingerprint_bits(false_positive_rate),
+                                 buckets_for(capacity)))
+{
+}
+
+seen_set::seen_set(std::unique_ptr<impl> i)
+  : impl_(std::move(i))
+{
+}
+
+seen_set::~seen_set() = default;
+
+seen_set::seen_set(seen_set&&) noexcept = default;
+seen_set& seen_set::operator=(seen_set&&) noexcept = default;
+
+bool seen_set::insert(std::string_view normalized)
+{
+  return impl_->insert(fingerprint_of(normalized));
+}
+
+bool seen_set::contains(std::string_view normalized) const
+{
+  return impl_->contains(fingerprint_of(normalized));
+}
+
+void seen_set::insert(std::string_view const* normalized,
+                      std::size_t             n,
+                      bool*                   added)
+{
+  fingerprint h[batch];
+  for (std::size_t first = 0; first < n; first += batch) {
+    auto const count = std::min(batch, n - first);
+    for (std::size_t i = 0; i < count; ++i) {
+      h[i] = fingerprint_of(normalized[first + i]);
+      std::visit([&h, i](auto const& t) { t.prefetch(h[i]); }, impl_->table);
+    }
+    for (std::size_t i = 0; i < count; ++i)
+      added[first + i] = impl_->insert(h[i]);
+  }
+}
+
+void seen_set::contains(std::string_view const* normalized,
+                        std::size_t             n,
+                        bool*                   found) const
+{
+  fingerprint h[batch];
+  for (std::size_t first = 0; first < n; first += batch) {
+    auto const count = std::min(batch, n - first);
+    for (std::size_t i = 0; i < count; ++i) {
+      h[i] = fingerprint_of(normalized[first + i]);
+      std::visit([&h, i](auto const& t) { t.prefetch(h[i]); }, impl_->table);
+    }
+    for (std::size_t i = 0; i < count; ++i)
+      found[first + i] = impl_->contains(h[i]);
+  }
+}
+
+std::uint64_t seen_set::size() const
+{
+  return impl_->size.load(std::memory_order_relaxed);
+}
+
+std::uint64_t seen_set::capacity() const
+{
+  return static_cast<std::uint64_t>(impl_->n_buckets * slots_per_bucket
+                                    * max_load);
+}
+
+int seen_set::fingerprint_bits() const { return impl_->bits; }
+
+// magic, fingerprint bits, buckets, size, then the slots.
+void seen_set::save(std::string const& path) const
+{
+  // No kicks, and no inserts: those that began before saving was set
+  // hold their stripes until they're done.  Lookups go on.
+  std::lock_guard<std::mutex> kick(impl_->kick_mutex);
+  impl_->saving = true;
+  at_exit done{[this] { impl_->saving = false; }};
+  for (auto& stripe : impl_->stripes) {
+    stripe.lock();
+    stripe.unlock();
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+  std::uint64_t const header[] = {
+      static_cast<std::uint64_t>(impl_->bits),
+      impl_->n_buckets,
+      impl_->size.load(std::memory_order_relaxed),
+  };
+  file.write(magic, sizeof(magic));
+  file.write(reinterpret_cast<char const*>(header), sizeof(header));
+  std::visit([&file](auto const& t) { file.write(t.data(), t.bytes()); },
+             impl_->table);
+
+  if (!file.flush())
+    throw std::runtime_error("can't write " + path);
+}
+
+seen_set seen_set::load(std::string const& path)
+{
+  std::ifstream file(path, std::ios::binary);
+
+  char          file_magic[sizeof(magic)];
+  std::uint64_t header[3];
+  file.read(file_magic, sizeof(file_magic));
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!file || std::memcmp(file_magic, magic, sizeof(magic))
+      || (header[1] == 0) || (header[1] > max_buckets)
+      || (header[1] & (header[1] - 1)))
+    throw std::runtime_error("not a seen_set file: " + path);
+
+  auto i = std::make_unique<impl>(static_cast<int>(header[0]), header[1]);
+  i->size = header[2];
+  std::visit([&file](auto& t) { file.read(t.data(), t.bytes()); }, i->table);
+  if (!file)
+    throw std::runtime_error("short seen_set file: " + path);
+
+  return seen_set(std::move(i));
+}
+
+} // namespace uri
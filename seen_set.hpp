@@ -0,0 +1,72 @@
+#ifndef SEEN_SET_HPP_INCLUDED
+#define SEEN_SET_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A set of URIs that keeps only a fingerprint of each, for a crawler's
+// "have we seen this one?"  It's a cuckoo filter: 8, 16 or 32 bits per
+// URI, depending on the false positive rate asked for, and some slack.
+// There are no false negatives; a false positive is a URI never added
+// that contains() finds anyway.  Each URI is hashed once, by
+// fingerprint_of(), which picks both its bucket and what is kept.
+//
+// Add what normalize() returns, or a uri built with norm = true, so
+// that the different spellings of a URI count as one.
+//
+// Any number of threads may insert and look up at once; lookups take
+// no lock.  Two threads adding the same URI will not both be told it
+// was new.
+
+namespace uri {
+
+class DLL_PUBLIC seen_set {
+public:
+  // Room for capacity URIs.
+  explicit seen_set(std::uint64_t capacity,
+                    double        false_positive_rate = 1e-3);
+  ~seen_set();
+
+  seen_set(seen_set&&) noexcept;
+  seen_set& operator=(seen_set&&) noexcept;
+
+  // True if it was not already there.  Throws std::length_error if
+  // there is no more room.
+  bool insert(std::string_view normalized);
+  bool insert(uri const& u) { return insert(u.string()); }
+
+  bool contains(std::string_view normalized) const;
+  bool contains(uri const& u) const { return contains(u.string()); }
+
+  // The same for n at a time, which is faster: the memory for each is
+  // fetched while working on the ones before.
+  void insert(std::string_view const* normalized, std::size_t n, bool* added);
+  void contains(std::string_view const* normalized,
+                std::size_t             n,
+                bool*                   found) const;
+
+  std::uint64_t size() const;     // number inserted
+  std::uint64_t capacity() const; // the most that fit
+  int           fingerprint_bits() const;
+
+  // The slots go out just as they are, so only machines of the same
+  // endianness can load the file.  save() waits for inserts in
+  // progress, and holds off new ones; lookups go on.
+  void            save(std::string const& path) const;
+  static seen_set load(std::string const& path);
+
+private:
+  struct impl;
+
+  explicit seen_set(std::unique_ptr<impl> i);
+
+  std::unique_ptr<impl> impl_;
+};
+
+} // namespace uri
+
+#endif // SEEN_SET_HPP_INCLUDED
@@ -0,0 +1,575 @@
+#ifndef STATIC_URI_HPP_INCLUDED
+#define STATIC_URI_HPP_INCLUDED
+
+#include "grammar.hpp"
+#include "uri.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+// A constexpr restatement of the grammar in uri.cpp, so URI literals
+// can be checked and broken into components by the compiler.
+//
+//   constexpr auto home = "https://example.com/index.html"_uri;
+//   static_assert(home.host() == "example.com");
+//
+// Any literal that does not match the URI rule is a compile error when
+// the result is used in a constant expression, and a syntax_error
+// exception otherwise.
+
+namespace uri {
+namespace grammar {
+
+// Each member function is one rule from uri.cpp with the same name.
+// A rule that fails leaves pos_ where it found it, just like PEGTL.
+
+class parser {
+public:
+  struct span {
+    std::size_t offset{std::string_view::npos};
+    std::size_t length{0};
+  };
+
+  constexpr explicit parser(std::string_view in)
+    : in_(in)
+  {
+  }
+
+  constexpr bool URI_eof() { return URI() && eof(); }
+
+  // clang-format off
+  span scheme;
+  span authority;
+  span userinfo;
+  span host;
+  span port;
+  span path;
+  span query;
+  span fragment;
+  // clang-format on
+
+  // As uri.cpp fills in components from the host and port rules.
+  host_kind                    host_type{host_kind::none};
+  std::optional<std::uint16_t> port_value;
+  std::uint8_t                 address[16]{}; // network order
+
+private:
+  constexpr bool eof() const { return pos_ == in_.size(); }
+
+  constexpr unsigned char peek(std::size_t n = 0) const
+  {
+    return static_cast<unsigned char>(in_[pos_ + n]);
+  }
+
+  constexpr bool avail(std::size_t n) const { return in_.size() - pos_ >= n; }
+
+  constexpr bool one(char c)
+  {
+    if (!eof() && (peek() == static_cast<unsigned char>(c))) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  constexpr bool two(char c)
+  {
+    if (avail(2) && (peek(0) == static_cast<unsigned char>(c))
+        && (peek(1) == static_cast<unsigned char>(c))) {
+      pos_ += 2;
+      return true;
+    }
+    return false;
+  }
+
+  constexpr bool range(unsigned char lo, unsigned char hi)
+  {
+    if (!eof() && (lo <= peek()) && (peek() <= hi)) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  constexpr void mark(span& s, std::size_t start) const
+  {
+    s.offset = start;
+    s.length = pos_ - start;
+  }
+
+  constexpr bool ALPHA() { return range('a', 'z') || range('A', 'Z'); }
+
+  constexpr bool DIGIT() { return range('0', '9'); }
+
+  constexpr bool HEXDIG()
+  {
+    return range('0', '9') || range('a', 'f') || range('A', 'F');
+  }
+
+  constexpr bool UTF8_tail() { return range(0x80, 0xBF); }
+
+  constexpr bool UTF8_non_ascii()
+  {
+    auto const start = pos_;
+    if (eof())
+      return false;
+    auto const c = peek();
+    ++pos_;
+    bool ok = false;
+    if ((0xC2 <= c) && (c <= 0xDF))
+      ok = UTF8_tail();
+    else if (c == 0xE0)
+      ok = range(0xA0, 0xBF) && UTF8_tail();
+    else if (((0xE1 <= c) && (c <= 0xEC)) || (c == 0xEE) || (c == 0xEF))
+      ok = UTF8_tail() && UTF8_tail();
+    else if (c == 0xED)
+      ok = range(0x80, 0x9F) && UTF8_tail();
+    else if (c == 0xF0)
+      ok = range(0x90, 0xBF) && UTF8_tail() && UTF8_tail();
+    else if ((0xF1 <= c) && (c <= 0xF3))
+      ok = UTF8_tail() && UTF8_tail() && UTF8_tail();
+    else if (c == 0xF4)
+      ok = range(0x80, 0x8F) && UTF8_tail() && UTF8_tail();
+    if (!ok)
+      pos_ = start;
+    return ok;
+  }
+
+  constexpr bool sub_delims()
+  {
+    if (eof())
+      return false;
+    // clang-format off
+    switch (peek()) {
+      case '!': case '$': case '&': case '\'': case '(': case ')':
+      case '*': case '+': case ',': case ';': case '=':
+        ++pos_;
+        return true;
+    }
+    return false;
+    // clang-format on
+  }
+
+  constexpr bool unreserved()
+  {
+    return ALPHA() || DIGIT() || one('-') || one('.') || one('_') || one('~')
+           || UTF8_non_ascii();
+  }
+
+  constexpr bool pct_encoded()
+  {
+    auto const start = pos_;
+    if (one('%') && HEXDIG() && HEXDIG())
+      return true;
+    pos_ = start;
+    return false;
+  }
+
+  constexpr bool pchar()
+  {
+    return unreserved() || pct_encoded() || sub_delims() || one(':')
+           || one('@');
+  }
+
+  constexpr bool query_fragment_char()
+  {
+    return pchar() || one('/') || one('?');
+  }
+
+  constexpr bool segment_nz_nc()
+  {
+    auto const start = pos_;
+    while (unreserved() || pct_encoded() || sub_delims() || one('@'))
+      ;
+    return pos_ != start;
+  }
+
+  constexpr bool segment_nz()
+  {
+    auto const start = pos_;
+    while (pchar())
+      ;
+    return pos_ != start;
+  }
+
+  constexpr bool segment()
+  {
+    while (pchar())
+      ;
+    return true;
+  }
+
+  constexpr bool slash_segments()
+  {
+    while (one('/'))
+      segment();
+    return true;
+  }
+
+  constexpr bool path_abempty()
+  {
+    auto const start = pos_;
+    slash_segments();
+    mark(path, start);
+    return true;
+  }
+
+  constexpr bool path_absolute()
+  {
+    auto const start = pos_;
+    if (!one('/'))
+      return false;
+    if (segment_nz())
+      slash_segments();
+    mark(path, start);
+    return true;
+  }
+
+  constexpr bool path_rootless()
+  {
+    auto const start = pos_;
+    if (!segment_nz())
+      return false;
+    slash_segments();
+    mark(path, start);
+    return true;
+  }
+
+  constexpr bool path_empty()
+  {
+    mark(path, pos_);
+    return true;
+  }
+
+  // reg-name, the RFC-1123 way; see uri.cpp and grammar.hpp.
+  constexpr bool reg_name()
+  {
+    auto const n = grammar::reg_name(in_.substr(pos_));
+    pos_ += n;
+    return n != 0;
+  }
+
+  constexpr bool dec_octet()
+  {
+    auto const start = pos_;
+    if (one('2') && one('5') && range('0', '5'))
+      return true;
+    pos_ = start;
+    if (one('2') && range('0', '4') && DIGIT())
+      return true;
+    pos_ = start;
+    if (one('1') && DIGIT() && DIGIT())
+      return true;
+    pos_ = start;
+    if (range('1', '9') && DIGIT())
+      return true;
+    pos_ = start;
+    return DIGIT();
+  }
+
+  constexpr bool IPv4address()
+  {
+    auto const start = pos_;
+    if (dec_octet() && one('.') && dec_octet() && one('.') && dec_octet()
+        && one('.') && dec_octet())
+      return true;
+    pos_ = start;
+    return false;
+  }
+
+  // See grammar.hpp.
+  constexpr bool IPv6address()
+  {
+    auto const n = grammar::IPv6address(in_.substr(pos_), address);
+    pos_ += n;
+    return n != 0;
+  }
+
+  constexpr bool IPvFuture()
+  {
+    auto const start = pos_;
+    if (one('v') && HEXDIG()) {
+      while (HEXDIG())
+        ;
+      if (one('.') && (unreserved() || sub_delims() || one(':'))) {
+        while (unreserved() || sub_delims() || one(':'))
+          ;
+        return true;
+      }
+    }
+    pos_ = start;
+    return false;
+  }
+
+  constexpr bool IP_literal()
+  {
+    auto const start = pos_;
+    if (one('[') && (IPv6address() || IPvFuture()) && one(']'))
+      return true;
+    pos_ = start;
+    return false;
+  }
+
+  constexpr bool digits(int n)
+  {
+    auto const start = pos_;
+    for (auto i = 0; i < n; ++i) {
+      if (!DIGIT()) {
+        pos_ = start;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr bool literal(std::string_view s)
+  {
+    if (avail(s.size()) && (in_.substr(pos_, s.size()) == s)) {
+      pos_ += s.size();
+      return true;
+    }
+    return false;
+  }
+
+  // An unsigned 16 bit number, with the same alternatives as uri.cpp.
+  constexpr bool port_number()
+  {
+    auto const start = pos_;
+    if (literal("6553") && range('0', '5'))
+      return true;
+    pos_ = start;
+    if (literal("655") && range('0', '2') && DIGIT())
+      return true;
+    pos_ = start;
+    if (literal("65") && range('0', '4') && digits(2))
+      return true;
+    pos_ = start;
+    if (one('6') && range('0', '4') && digits(3))
+      return true;
+    pos_ = start;
+    if (range('0', '5') && digits(4))
+      return true;
+    pos_ = start;
+    for (auto n = 0; (n < 4) && DIGIT(); ++n)
+      ;
+    if (eof() || !((peek() >= '0') && (peek() <= '9')))
+      return true;
+    pos_ = start;
+    return literal("00000");
+  }
+
+  constexpr bool host_rule()
+  {
+    auto const start = pos_;
+    if (IP_literal()) {
+      host_type = (in_[start + 1] == 'v') ? host_kind::IPvFuture
+                                          : host_kind::IPv6;
+    }
+    else if (IPv4address()) {
+      host_type = host_kind::IPv4;
+      IPv4_tail(in_.substr(start, pos_ - start), address);
+    }
+    else if (reg_name()) {
+      host_type = host_kind::reg_name;
+    }
+    else {
+      return false;
+    }
+    mark(host, start);
+    return true;
+  }
+
+  // The value of a port, as uri_internal::port_number() has it: none
+  // for an empty port, or one too big for 16 bits.
+  static constexpr std::optional<std::uint16_t> number(std::string_view port)
+  {
+    if (port.empty() || (port.size() > 5))
+      return {};
+    std::uint32_t p = 0;
+    for (auto ch : port)
+      p = 10 * p + (ch - '0');
+    if (p > 0xFFFF)
+      return {};
+    return static_cast<std::uint16_t>(p);
+  }
+
+  constexpr bool userinfo_at()
+  {
+    auto const start = pos_;
+    while (unreserved() || pct_encoded() || sub_delims() || one(':'))
+      ;
+    auto const end = pos_;
+    if (one('@')) {
+      userinfo = span{start, end - start};
+      return true;
+    }
+    pos_ = start;
+    return false;
+  }
+
+  constexpr bool authority_rule()
+  {
+    auto const start = pos_;
+    userinfo_at();
+    if (!host_rule()) {
+      pos_ = start;
+      return false;
+    }
+    auto const colon = pos_;
+    if (one(':')) {
+      auto const port_start = pos_;
+      if (port_number()) {
+        mark(port, port_start);
+        port_value = number(in_.substr(port_start, pos_ - port_start));
+      }
+      else
+        pos_ = colon;
+    }
+    mark(authority, start);
+    return true;
+  }
+
+  constexpr bool scheme_colon()
+  {
+    auto const start = pos_;
+    if (ALPHA()) {
+      while (ALPHA() || DIGIT() || one('+') || one('-') || one('.'))
+        ;
+      auto const end = pos_;
+      if (one(':')) {
+        scheme = span{start, end - start};
+        return true;
+      }
+    }
+    pos_ = start;
+    return false;
+  }
+
+  constexpr bool hier_part()
+  {
+    auto const start = pos_;
+    if (two('/')) {
+      if (authority_rule() && path_abempty())
+        return true;
+      pos_ = start;
+    }
+    return path_absolute() || path_rootless() || path_empty();
+  }
+
+  constexpr bool query_rule()
+  {
+    if (!one('?'))
+      return false;
+    auto const start = pos_;
+    while (query_fragment_char())
+      ;
+    mark(query, start);
+    return true;
+  }
+
+  constexpr bool fragment_rule()
+  {
+    if (!one('#'))
+      return false;
+    auto const start = pos_;
+    while (query_fragment_char())
+      ;
+    mark(fragment, start);
+    return true;
+  }
+
+  constexpr bool URI()
+  {
+    if (!scheme_colon())
+      return false;
+    hier_part();
+    query_rule();
+    fragment_rule();
+    return true;
+  }
+
+  std::string_view in_;
+  std::size_t      pos_{0};
+};
+
+} // namespace grammar
+
+// A generic URI that lives in a string literal, already parsed.
+
+class static_uri {
+public:
+  constexpr explicit static_uri(std::string_view uri_in)
+    : uri_(uri_in)
+    , parts_(uri_in)
+  {
+    if (!parts_.URI_eof())
+      throw syntax_error();
+  }
+
+  // clang-format off
+  constexpr auto scheme()    const { return get_(parts_.scheme); }
+  constexpr auto authority() const { return get_(parts_.authority); }
+  constexpr auto userinfo()  const { return get_(parts_.userinfo); }
+  constexpr auto host()      const { return get_(parts_.host); }
+  constexpr auto port()      const { return get_(parts_.port); }
+  constexpr auto path()      const { return get_(parts_.path); }
+  constexpr auto query()     const { return get_(parts_.query); }
+  constexpr auto fragment()  const { return get_(parts_.fragment); }
+  // clang-format on
+
+  // The address of an IPv4 or IPv6 host.  Not constexpr: before C++20 a
+  // constant expression can't make v6 the member of the union in use.
+  ip_address address() const
+  {
+    ip_address addr{};
+    if ((parts_.host_type == host_kind::IPv4)
+        || (parts_.host_type == host_kind::IPv6))
+      std::memcpy(&addr, parts_.address, sizeof addr);
+    return addr;
+  }
+
+  // The address is left zero in a constant expression, and filled in at
+  // run time only where the compiler can tell the two apart, which GCC
+  // and Clang can.  Elsewhere it is always zero: use address().
+  constexpr component_views parts() const
+  {
+    component_views views{scheme(), authority(), userinfo(), host(),
+                          port(),   path(),      query(),    fragment(),
+                          parts_.host_type, parts_.port_value, ip_address{}};
+#ifdef __GNUC__
+    if (!__builtin_is_constant_evaluated())
+      views.address = address();
+#else
+    // No way to tell at compile time from run time in C++17.
+#endif
+    return views;
+  }
+
+  constexpr std::string_view string() const { return uri_; }
+
+private:
+  constexpr std::optional<std::string_view>
+  get_(grammar::parser::span const& s) const
+  {
+    if (s.offset == std::string_view::npos)
+      return {};
+    return uri_.substr(s.offset, s.length);
+  }
+
+  std::string_view uri_;
+  grammar::parser  parts_;
+};
+
+namespace literals {
+constexpr static_uri operator""_uri(char const* str, std::size_t len)
+{
+  return static_uri{std::string_view{str, len}};
+}
+} // namespace literals
+
+} // namespace uri
+
+#endif // STATIC_URI_HPP_INCLUDED
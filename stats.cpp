@@ -0,0 +1,146 @@
+#define BUILDING_DLL
+#include "uri_stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using namespace uri::stats;
+
+using cell = std::atomic<std::uint64_t>;
+
+// Only the owning thread writes to a block, so a relaxed load and
+// store will do: no read-modify-write, no lock prefix.
+void bump(cell& c, std::uint64_t n = 1)
+{
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct block {
+  struct hist {
+    std::array<cell, histogram::n_buckets> buckets{};
+    cell                                   count{0};
+    cell                                   total_ns{0};
+  };
+
+  std::array<cell, n_counters> counters{};
+  std::array<hist, n_stages>   latency{};
+};
+
+void add_to(snapshot& sum, block const& b)
+{
+  for (std::size_t c = 0; c < n_counters; ++c)
+    sum.counters[c] += b.counters[c].load(std::memory_order_relaxed);
+  for (std::size_t s = 0; s < n_stages; ++s) {
+    auto&       to   = sum.latency[s];
+    auto const& from = b.latency[s];
+    for (std::size_t i = 0; i < histogram::n_buckets; ++i)
+      to.buckets[i] += from.buckets[i].load(std::memory_order_relaxed);
+    to.count += from.count.load(std::memory_order_relaxed);
+    to.total_ns += from.total_ns.load(std::memory_order_relaxed);
+  }
+}
+
+std::mutex          registry_mutex;
+std::vector<block*> live_blocks;
+snapshot            retired; // from threads that have exited
+
+struct thread_block {
+  block b;
+
+  thread_block()
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    live_blocks.push_back(&b);
+  }
+  ~thread_block()
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    add_to(retired, b);
+    live_blocks.erase(std::find(live_blocks.begin(), live_blocks.end(), &b));
+  }
+};
+
+block& this_thread()
+{
+  thread_local thread_block tb;
+  return tb.b;
+}
+
+std::size_t bucket(std::uint64_t ns)
+{
+  if (ns == 0)
+    return 0;
+  auto const log2 = static_cast<std::size_t>(63 - __builtin_clzll(ns));
+  return std::min(log2, histogram::n_buckets - 1);
+}
+
+} // namespace
+
+namespace uri {
+namespace stats {
+
+DLL_PUBLIC snapshot take_snapshot()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  snapshot sum = retired;
+  for (auto b : live_blocks)
+    add_to(sum, *b);
+  return sum;
+}
+
+DLL_PUBLIC std::string_view name(counter c)
+{
+  switch (c) {
+  case counter::parse_generic: return "parse_generic";
+  case counter::parse_relative_ref: return "parse_relative_ref";
+  case counter::parse_reference: return "parse_reference";
+  case counter::parse_absolute: return "parse_absolute";
+  case counter::parse_failure: return "parse_failure";
+  case counter::normalize: return "normalize";
+  case counter::resolve_ref: return "resolve_ref";
+  case counter::resolve_merge: return "resolve_merge";
+  case counter::n_counters: break;
+  }
+  return "unknown";
+}
+
+DLL_PUBLIC std::string_view name(stage s)
+{
+  switch (s) {
+  case stage::parse: return "parse";
+  case stage::normalize: return "normalize";
+  case stage::normalize_host: return "normalize_host";
+  case stage::normalize_pct_encoded: return "normalize_pct_encoded";
+  case stage::nfkc: return "nfkc";
+  case stage::idna: return "idna";
+  case stage::remove_dot_segments: return "remove_dot_segments";
+  case stage::resolve_ref: return "resolve_ref";
+  case stage::n_stages: break;
+  }
+  return "unknown";
+}
+
+namespace detail {
+
+DLL_PUBLIC void count(counter c)
+{
+  bump(this_thread().counters[static_cast<std::size_t>(c)]);
+}
+
+DLL_PUBLIC void record(stage s, std::uint64_t ns)
+{
+  auto& h = this_thread().latency[static_cast<std::size_t>(s)];
+  bump(h.buckets[bucket(ns)]);
+  bump(h.count);
+  bump(h.total_ns, ns);
+}
+
+} // namespace detail
+
+} // namespace stats
+} // namespace uri
@@ -0,0 +1,254 @@
+#define BUILDING_DLL
+#include "surt.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct item {
+  std::string_view key;
+  std::size_t      index;
+};
+
+// Octet depth of key plus one, or zero past its end, which sorts first.
+inline unsigned digit(item const& it, std::size_t depth)
+{
+  return (depth < it.key.size())
+             ? 1u + static_cast<unsigned char>(it.key[depth])
+             : 0u;
+}
+
+// Fewer than this many items are sorted by insertion.
+constexpr std::ptrdiff_t few = 32;
+
+// Deeper than this, std::sort() takes over, to keep the stack short.
+constexpr std::size_t max_depth = 512;
+
+bool less_from(item const& a, item const& b, std::size_t depth)
+{
+  return a.key.substr(std::min(depth, a.key.size()))
+         < b.key.substr(std::min(depth, b.key.size()));
+}
+
+void insertion_sort(item* first, item* last, std::size_t depth)
+{
+  for (auto i = first + 1; i < last; ++i) {
+    auto const it = *i;
+    auto       j  = i;
+    for (; (j != first) && less_from(it, j[-1], depth); --j)
+      *j = j[-1];
+    *j = it;
+  }
+}
+
+// How many octets past depth all of [first, last) have in common.
+std::size_t common_prefix(item const* first, item const* last,
+                          std::size_t depth)
+{
+  auto const  key  = first->key.substr(std::min(depth, first->key.size()));
+  std::size_t size = key.size();
+  for (auto p = first + 1; (p != last) && size; ++p) {
+    auto const other = p->key.substr(std::min(depth, p->key.size()));
+    auto const n     = std::min(size, other.size());
+    size             = std::mismatch(key.data(), key.data() + n, other.data())
+               .first
+           - key.data();
+  }
+  return size;
+}
+
+using bucket_ends = std::array<std::size_t, 257>;
+
+// Puts [first, last) in order on octet depth, by way of aux, and returns
+// where each bucket ends.
+bucket_ends partition(item* first, item* last, item* aux, std::size_t depth)
+{
+  bucket_ends ends{};
+  for (auto p = first; p != last; ++p)
+    ++ends[digit(*p, depth)];
+
+  std::size_t sum = 0;
+  for (auto& e : ends) {
+    auto const count = e;
+    e = sum; // for now, where each bucket starts
+    sum += count;
+  }
+  for (auto p = first; p != last; ++p)
+    aux[ends[digit(*p, depth)]++] = *p;
+  std::copy(aux, aux + (last - first), first);
+  return ends;
+}
+
+// All of [first, last) share their first depth octets.
+void msd_sort(item* first, item* last, item* aux, std::size_t depth)
+{
+  auto const n = last - first;
+  if (n < few) {
+    insertion_sort(first, last, depth);
+    return;
+  }
+
+  // A prefix all the keys share, as URIs on one site do, is stepped over
+  // in one go rather than an octet at a time.
+  depth += common_prefix(first, last, depth);
+  if (depth > max_depth) {
+    std::sort(first, last, [depth](item const& a, item const& b) {
+      return less_from(a, b, depth);
+    });
+    return;
+  }
+
+  auto const ends = partition(first, last, aux, depth);
+  if (ends[0] == std::size_t(n))
+    return; // every key ends here, so all are the same
+
+  std::size_t start = ends[0];
+  for (std::size_t b = 1; b < ends.size(); ++b) {
+    if (ends[b] - start > 1)
+      msd_sort(first + start, first + ends[b], aux + start, depth + 1);
+    start = ends[b];
+  }
+}
+
+// Ranges still to sort, shared by the threads sorting them.
+class work_queue {
+public:
+  struct range {
+    item*       first;
+    item*       last;
+    std::size_t depth;
+  };
+
+  void push(range r)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    todo_.push_back(r);
+    ++pending_;
+    ready_.notify_one();
+  }
+
+  // The next range, or false once all are done.
+  bool pop(range& r)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return !todo_.empty() || (pending_ == 0); });
+    if (todo_.empty())
+      return false;
+    r = todo_.back();
+    todo_.pop_back();
+    return true;
+  }
+
+  // A range from pop() is finished with, and any it split into pushed.
+  void done()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0)
+      ready_.notify_all();
+  }
+
+private:
+  std::mutex              mutex_;
+  std::condition_variable ready_;
+  std::vector<range>      todo_;
+  std::size_t             pending_{0}; // in todo_, or popped and not done
+};
+
+void parallel_sort(item* first, item* last, item* aux, unsigned threads)
+{
+  auto const n = static_cast<std::size_t>(last - first);
+
+  // Ranges bigger than this are split between threads, smaller ones
+  // sorted by the one that has them.
+  auto const split = std::max<std::size_t>(n / (4 * threads), 1 << 14);
+
+  work_queue queue;
+  queue.push({first, last, 0});
+
+  auto const worker = [&queue, first, aux, split] {
+    work_queue::range r;
+    while (queue.pop(r)) {
+      auto const r_aux = aux + (r.first - first);
+      auto const size  = static_cast<std::size_t>(r.last - r.first);
+      if ((size <= split) || (r.depth > max_depth)) {
+        msd_sort(r.first, r.last, r_aux, r.depth);
+      }
+      else {
+        r.depth += common_prefix(r.first, r.last, r.depth);
+        auto const  ends  = partition(r.first, r.last, r_aux, r.depth);
+        std::size_t start = ends[0];
+        for (std::size_t b = 1; b < ends.size(); ++b) {
+          if (ends[b] - start > 1)
+            queue.push({r.first + start, r.first + ends[b], r.depth + 1});
+          start = ends[b];
+        }
+      }
+      queue.done();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool)
+    t.join();
+}
+
+std::vector<item> sorted_items(std::vector<std::string_view> const& keys,
+                               unsigned                             threads)
+{
+  std::vector<item> items(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    items[i] = {keys[i], i};
+  if (items.size() < 2)
+    return items;
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<item> aux(items.size());
+  auto const        first = items.data();
+  auto const        last  = first + items.size();
+  if ((threads == 1) || (items.size() < (1 << 16)))
+    msd_sort(first, last, aux.data(), 0);
+  else
+    parallel_sort(first, last, aux.data(), threads);
+  return items;
+}
+
+} // namespace
+
+namespace uri {
+
+std::vector<std::size_t>
+radix_order(std::vector<std::string_view> const& keys, unsigned threads)
+{
+  auto const               items = sorted_items(keys, threads);
+  std::vector<std::size_t> order(items.size());
+  std::transform(begin(items), end(items), begin(order),
+                 [](item const& it) { return it.index; });
+  return order;
+}
+
+void radix_sort(std::vector<std::string>& keys, unsigned threads)
+{
+  std::vector<std::string_view> views(begin(keys), end(keys));
+  auto                          order = radix_order(views, threads);
+  views.clear();
+  views.shrink_to_fit();
+  detail::apply_order(keys, order);
+}
+
+void radix_sort(std::vector<std::string_view>& keys, unsigned threads)
+{
+  auto const items = sorted_items(keys, threads);
+  std::transform(begin(items), end(items), begin(keys),
+                 [](item const& it) { return it.key; });
+}
+
+} // namespace uri
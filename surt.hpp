@@ -0,0 +1,92 @@
+#ifndef SURT_HPP_INCLUDED
+#define SURT_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Sorting a great many URIs, or their surt_key()s, by a most significant
+// digit radix sort.  Each pass puts the keys in 256 buckets on one octet
+// and moves on to the next octet in each bucket, so no two keys are ever
+// compared whole, and a run of keys with a long common prefix, as URIs
+// on one site are, is walked once rather than at every comparison.
+// Buckets big enough to be worth it are shared out between threads;
+// small ones are finished off by insertion sort.
+//
+//   std::vector<uri::generic> uris = ...;
+//   uri::sort_by_surt(uris);
+
+namespace uri {
+
+// The order of keys, sorted as std::sort() would sort them, octets
+// compared as unsigned char: keys[order[0]] is first.  threads is how
+// many to use, zero for one a core.
+DLL_PUBLIC std::vector<std::size_t>
+           radix_order(std::vector<std::string_view> const& keys,
+                       unsigned                             threads = 0);
+
+DLL_PUBLIC void radix_sort(std::vector<std::string>& keys,
+                           unsigned                  threads = 0);
+DLL_PUBLIC void radix_sort(std::vector<std::string_view>& keys,
+                           unsigned                       threads = 0);
+
+namespace detail {
+// Puts v[order[i]] at v[i], one swap for each element out of place;
+// order is used up.
+template <typename T>
+void apply_order(std::vector<T>& v, std::vector<std::size_t>& order)
+{
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    // Follow the cycle through i, leaving each place's own index behind.
+    auto at = i;
+    while (order[at] != i) {
+      auto const from = order[at];
+      using std::swap;
+      swap(v[at], v[from]);
+      order[at] = at;
+      at        = from;
+    }
+    order[at] = at;
+  }
+}
+} // namespace detail
+
+// The order of uris by their surt_key()s, which are made once each.
+template <typename URI>
+std::vector<std::size_t> surt_order(std::vector<URI> const& uris,
+                                    unsigned                threads = 0)
+{
+  std::string              text; // all the keys, end to end
+  std::vector<std::size_t> ends;
+  std::string              key;
+  ends.reserve(uris.size());
+  for (auto const& u : uris) {
+    surt_key(u, key);
+    text += key;
+    ends.push_back(text.size());
+  }
+
+  std::vector<std::string_view> keys;
+  keys.reserve(uris.size());
+  std::size_t start = 0;
+  for (auto const end : ends) {
+    keys.emplace_back(text.data() + start, end - start);
+    start = end;
+  }
+  return radix_order(keys, threads);
+}
+
+template <typename URI>
+void sort_by_surt(std::vector<URI>& uris, unsigned threads = 0)
+{
+  auto order = surt_order(uris, threads);
+  detail::apply_order(uris, order);
+}
+
+} // namespace uri
+
+#endif // SURT_HPP_INCLUDED
@@ -0,0 +1,478 @@
+#define BUILDING_DLL
+#include "table.hpp"
+
+#include "mapped_file.hpp"
+#include "uri_internal.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr char magic[8] = {'U', 'R', 'I', 'T', 'A', 'B', '0', '1'};
+
+// The flags of a row, with its host_kind in the top three bits.
+enum flag : std::uint8_t {
+  has_authority = 1 << 0,
+  has_path      = 1 << 1,
+  has_query     = 1 << 2,
+  has_fragment  = 1 << 3,
+  is_normalized = 1 << 4,
+};
+
+constexpr int host_kind_shift = 5;
+
+std::uint8_t present_flag(uri::table::part which)
+{
+  switch (which) {
+  case uri::table::part::path: return has_path;
+  case uri::table::part::query: return has_query;
+  case uri::table::part::fragment: return has_fragment;
+  }
+  return 0;
+}
+
+// LEB128: seven bits at a time, low first, the high bit set on all but
+// the last.
+void put_varint(std::size_t n, uri::detail::column<char>& out)
+{
+  while (n >= 0x80) {
+    out.push_back(static_cast<char>(n | 0x80));
+    n >>= 7;
+  }
+  out.push_back(static_cast<char>(n));
+}
+
+std::size_t get_varint(char const*& p)
+{
+  std::size_t n     = 0;
+  int         shift = 0;
+  for (;;) {
+    auto const b = static_cast<unsigned char>(*p++);
+    n |= std::size_t(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return n;
+    shift += 7;
+  }
+}
+
+// Each array in a file is its element count, then the elements, padded
+// to 8 octets.
+
+template <typename T>
+void write_array(std::ostream& os, T const* data, std::size_t n)
+{
+  static char const zeros[8] = {};
+
+  std::uint64_t const count = n;
+  os.write(reinterpret_cast<char const*>(&count), sizeof(count));
+  os.write(reinterpret_cast<char const*>(data), n * sizeof(T));
+  os.write(zeros, (8 - (n * sizeof(T)) % 8) % 8);
+}
+
+template <typename T>
+void write_array(std::ostream& os, uri::detail::column<T> const& c)
+{
+  write_array(os, c.data(), c.size());
+}
+
+template <typename T>
+void map_array(uri::detail::column<T>& c, char const*& p, char const* end)
+{
+  std::uint64_t count;
+  if (end - p < std::ptrdiff_t(sizeof(count)))
+    throw std::runtime_error("short uri::table file");
+  std::memcpy(&count, p, sizeof(count));
+  p += sizeof(count);
+
+  auto const bytes = count * sizeof(T);
+  if ((count > std::uint64_t(end - p) / sizeof(T))
+      || (std::uint64_t(end - p) < bytes + (8 - bytes % 8) % 8))
+    throw std::runtime_error("short uri::table file");
+  c.map(reinterpret_cast<T const*>(p), count);
+  p += bytes + (8 - bytes % 8) % 8;
+}
+
+} // namespace
+
+namespace uri {
+namespace detail {
+
+//-----------------------------------------------------------------------------
+
+dictionary::id dictionary::intern(std::string_view s)
+{
+  if (2 * (size() + 1) > slots_.size())
+    rehash(std::max<std::size_t>(16, 2 * slots_.size()));
+
+  auto const mask = slots_.size() - 1;
+  auto       i    = std::hash<std::string_view>{}(s) & mask;
+  for (; slots_[i]; i = (i + 1) & mask) {
+    if ((*this)[slots_[i] - 1] == s)
+      return slots_[i] - 1;
+  }
+
+  auto const n = static_cast<id>(size());
+  if (n == none)
+    throw std::length_error("uri::table dictionary is full");
+  if (offsets_.size() == 0)
+    offsets_.push_back(0);
+  text_.append(s.data(), s.size());
+  offsets_.push_back(text_.size());
+  slots_[i] = n + 1;
+  return n;
+}
+
+void dictionary::rehash(std::size_t size)
+{
+  slots_.assign(size, 0);
+  auto const mask = size - 1;
+  for (id n = 0; n < this->size(); ++n) {
+    auto i = std::hash<std::string_view>{}((*this)[n]) & mask;
+    while (slots_[i])
+      i = (i + 1) & mask;
+    slots_[i] = n + 1;
+  }
+}
+
+std::size_t dictionary::memory() const
+{
+  return text_.memory() + offsets_.memory() + slots_.capacity() * sizeof(id);
+}
+
+void dictionary::save(std::ostream& os) const
+{
+  write_array(os, text_);
+  write_array(os, offsets_);
+}
+
+void dictionary::map(char const*& p, char const* end)
+{
+  map_array(text_, p, end);
+  map_array(offsets_, p, end);
+  if ((offsets_.size() == 1)
+      || (offsets_.size() && (offsets_[offsets_.size() - 1] != text_.size())))
+    throw std::runtime_error("bad uri::table dictionary");
+  slots_ = {};
+}
+
+//-----------------------------------------------------------------------------
+
+void front_coded::push_back(std::string_view s)
+{
+  if (size_ % restart == 0) {
+    restarts_.push_back(bytes_.size());
+    last_.clear();
+  }
+
+  auto const shared
+      = std::mismatch(s.begin(), s.end(), last_.begin(), last_.end()).first
+        - s.begin();
+  put_varint(shared, bytes_);
+  put_varint(s.size() - shared, bytes_);
+  bytes_.append(s.data() + shared, s.size() - shared);
+
+  last_.assign(s.data(), s.size());
+  ++size_;
+}
+
+void front_coded::repeat()
+{
+  std::string const last = std::move(last_);
+  push_back(last);
+}
+
+char const* front_coded::next(char const* at, std::string& value)
+{
+  auto const shared = get_varint(at);
+  auto const rest   = get_varint(at);
+  value.resize(shared);
+  value.append(at, rest);
+  return at + rest;
+}
+
+std::string_view front_coded::get(std::size_t i, std::string& scratch) const
+{
+  auto at = bytes_.data() + restarts_[i / restart];
+  for (auto n = i % restart + 1; n; --n)
+    at = next(at, scratch);
+  return scratch;
+}
+
+std::size_t front_coded::memory() const
+{
+  return bytes_.memory() + restarts_.memory() + last_.capacity();
+}
+
+void front_coded::save(std::ostream& os) const
+{
+  write_array(os, bytes_);
+  write_array(os, restarts_);
+}
+
+void front_coded::map(char const*& p, char const* end, std::size_t size)
+{
+  map_array(bytes_, p, end);
+  map_array(restarts_, p, end);
+  if (restarts_.size() != (size + restart - 1) / restart)
+    throw std::runtime_error("bad uri::table column");
+  size_ = size;
+  last_ = {};
+}
+
+} // namespace detail
+
+//-----------------------------------------------------------------------------
+
+table::scanner::scanner(table const& t, part which)
+  : table_(&t)
+  , present_(present_flag(which))
+{
+  switch (which) {
+  case part::path: at_ = t.paths_.first(); break;
+  case part::query: at_ = t.queries_.first(); break;
+  case part::fragment: at_ = t.fragments_.first(); break;
+  }
+}
+
+bool table::scanner::next(std::optional<std::string_view>& value)
+{
+  if (row_ == table_->size())
+    return false;
+  at_ = detail::front_coded::next(at_, value_);
+  if (table_->flags_[row_++] & present_)
+    value = value_;
+  else
+    value = {};
+  return true;
+}
+
+void table::add(uri const& u)
+{
+  add(u.parts(), u.normalized() ? form::normalized : form::unnormalized);
+}
+
+void table::add(components const& parts, form f)
+{
+  if (map_)
+    throw std::runtime_error("uri::table is mapped, and read only");
+  if (size() == std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("uri::table is full");
+
+  std::uint8_t flags = static_cast<std::uint8_t>(parts.host_type)
+                       << host_kind_shift;
+  if (parts.authority || parts.userinfo || parts.host || parts.port)
+    flags |= has_authority;
+  if (parts.path)
+    flags |= has_path;
+  if (parts.query)
+    flags |= has_query;
+  if (parts.fragment)
+    flags |= has_fragment;
+  if (f == form::normalized)
+    flags |= is_normalized;
+
+  schemes_.push_back(parts.scheme ? scheme_names_.intern(*parts.scheme)
+                                  : none);
+  hosts_.push_back(parts.host ? host_names_.intern(*parts.host) : none);
+
+  if (parts.userinfo || parts.port) {
+    extras_.push_back({static_cast<std::uint32_t>(size()),
+                       parts.userinfo ? userinfos_.intern(*parts.userinfo)
+                                      : none,
+                       parts.port ? ports_.intern(*parts.port) : none});
+  }
+
+  // An absent part repeats the one before, so as not to break the run
+  // of shared prefixes.
+  auto const push = [](detail::front_coded&                 column,
+                       std::optional<std::string> const& value) {
+    if (value)
+      column.push_back(*value);
+    else
+      column.repeat();
+  };
+  push(paths_, parts.path);
+  push(queries_, parts.query);
+  push(fragments_, parts.fragment);
+
+  flags_.push_back(flags);
+}
+
+table::extra const* table::find_extra(std::size_t i) const
+{
+  auto const first = extras_.data();
+  auto const last  = first + extras_.size();
+  auto const it    = std::lower_bound(first, last, i,
+                                   [](extra const& e, std::size_t row) {
+                                     return e.row < row;
+                                   });
+  return ((it != last) && (it->row == i)) ? it : nullptr;
+}
+
+component_views table::view(std::size_t i, buffers& buf) const
+{
+  component_views parts;
+
+  auto const flags = flags_[i];
+  parts.scheme     = scheme(i);
+  parts.host       = host(i);
+  parts.host_type  = static_cast<host_kind>(flags >> host_kind_shift);
+
+  if (auto const e = find_extra(i)) {
+    if (e->userinfo != none)
+      parts.userinfo = userinfos_[e->userinfo];
+    if (e->port != none)
+      parts.port = ports_[e->port];
+  }
+  if (parts.port)
+    parts.port_number = uri_internal::port_number(*parts.port);
+  if ((parts.host_type == host_kind::IPv4)
+      || (parts.host_type == host_kind::IPv6))
+    uri_internal::classify_host(*parts.host, parts.address);
+
+  if (flags & has_authority) {
+    buf.authority.clear();
+    if (parts.userinfo) {
+      buf.authority += *parts.userinfo;
+      buf.authority += '@';
+    }
+    if (parts.host)
+      buf.authority += *parts.host;
+    if (parts.port) {
+      buf.authority += ':';
+      buf.authority += *parts.port;
+    }
+    parts.authority = buf.authority;
+  }
+
+  auto const path = paths_.get(i, buf.path);
+  if (flags & has_path)
+    parts.path = path;
+  auto const query = queries_.get(i, buf.query);
+  if (flags & has_query)
+    parts.query = query;
+  auto const fragment = fragments_.get(i, buf.fragment);
+  if (flags & has_fragment)
+    parts.fragment = fragment;
+
+  return parts;
+}
+
+components table::at(std::size_t i) const
+{
+  buffers    buf;
+  auto const views = view(i, buf);
+
+  auto const copy = [](std::optional<std::string_view> const& v) {
+    return v ? std::optional<std::string>(*v) : std::nullopt;
+  };
+
+  components parts;
+  parts.scheme      = copy(views.scheme);
+  parts.authority   = copy(views.authority);
+  parts.userinfo    = copy(views.userinfo);
+  parts.host        = copy(views.host);
+  parts.port        = copy(views.port);
+  parts.path        = copy(views.path);
+  parts.query       = copy(views.query);
+  parts.fragment    = copy(views.fragment);
+  parts.host_type   = views.host_type;
+  parts.port_number = views.port_number;
+  parts.address     = views.address;
+  return parts;
+}
+
+bool table::normalized(std::size_t i) const
+{
+  return flags_[i] & is_normalized;
+}
+
+std::optional<std::string_view> table::scheme(std::size_t i) const
+{
+  if (schemes_[i] == none)
+    return {};
+  return scheme_names_[schemes_[i]];
+}
+
+std::optional<std::string_view> table::host(std::size_t i) const
+{
+  if (hosts_[i] == none)
+    return {};
+  return host_names_[hosts_[i]];
+}
+
+std::size_t table::memory() const
+{
+  if (map_)
+    return map_size_;
+  return flags_.memory() + schemes_.memory() + hosts_.memory()
+         + extras_.memory() + scheme_names_.memory() + host_names_.memory()
+         + userinfos_.memory() + ports_.memory() + paths_.memory()
+         + queries_.memory() + fragments_.memory();
+}
+
+// magic, rows, then the columns in the order they are declared.
+void table::save(std::string const& path) const
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+  std::uint64_t const rows = size();
+  file.write(magic, sizeof(magic));
+  file.write(reinterpret_cast<char const*>(&rows), sizeof(rows));
+
+  write_array(file, flags_);
+  write_array(file, schemes_);
+  write_array(file, hosts_);
+  write_array(file, extras_);
+  scheme_names_.save(file);
+  host_names_.save(file);
+  userinfos_.save(file);
+  ports_.save(file);
+  paths_.save(file);
+  queries_.save(file);
+  fragments_.save(file);
+
+  if (!file.flush())
+    throw std::runtime_error("can't write " + path);
+}
+
+table table::map(std::string const& path)
+{
+  table t;
+  t.map_ = uri_internal::map_file(path, t.map_size_);
+  if (t.map_size_ < sizeof(magic) + 8)
+    throw std::runtime_error("not a uri::table file: " + path);
+
+  auto       p   = static_cast<char const*>(t.map_.get());
+  auto const end = p + t.map_size_;
+  if (std::memcmp(p, magic, sizeof(magic)))
+    throw std::runtime_error("not a uri::table file: " + path);
+  std::uint64_t rows;
+  std::memcpy(&rows, p + sizeof(magic), sizeof(rows));
+  p += sizeof(magic) + sizeof(rows);
+
+  map_array(t.flags_, p, end);
+  map_array(t.schemes_, p, end);
+  map_array(t.hosts_, p, end);
+  map_array(t.extras_, p, end);
+  t.scheme_names_.map(p, end);
+  t.host_names_.map(p, end);
+  t.userinfos_.map(p, end);
+  t.ports_.map(p, end);
+  t.paths_.map(p, end, rows);
+  t.queries_.map(p, end, rows);
+  t.fragments_.map(p, end, rows);
+
+  if ((t.flags_.size() != rows) || (t.schemes_.size() != rows)
+      || (t.hosts_.size() != rows))
+    throw std::runtime_error("bad uri::table file: " + path);
+
+  return t;
+}
+
+} // namespace uri
@@ -0,0 +1,254 @@
+#ifndef TABLE_HPP_INCLUDED
+#define TABLE_HPP_INCLUDED
+
+#include "uri.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A column store for a great many URIs, in a fraction of the memory of
+// a vector of uri.  Schemes, hosts, userinfo and ports are interned,
+// with a 32 bit id for each row; paths, queries and fragments are front
+// coded in row order, each entry the length it shares with the one
+// before and the rest, starting afresh every 16 rows.  URIs added in
+// order, or grouped by site the way a crawler finds them, share most.
+//
+// Rows come back as component_views: the interned parts point into the
+// table, the rest into buffers the caller keeps from row to row.  A
+// saved table maps back read only, its columns used where they lie.
+//
+//   uri::table t;
+//   for (auto const& u : uris)
+//     t.add(u);
+//   uri::table::buffers buf;
+//   auto const parts = t.view(42, buf);
+
+namespace uri {
+namespace detail {
+
+// An array that is owned while a table is built, or points into the
+// file the table was mapped from.
+template <typename T>
+class column {
+public:
+  column() = default;
+  column(column&&) = default;
+  column& operator=(column&&) = default;
+
+  column(column const&) = delete;
+  column& operator=(column const&) = delete;
+
+  T const*    data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  T const& operator[](std::size_t i) const { return data_[i]; }
+
+  void push_back(T const& value)
+  {
+    owned_.push_back(value);
+    own();
+  }
+  void append(T const* first, std::size_t n)
+  {
+    owned_.insert(owned_.end(), first, first + n);
+    own();
+  }
+  void map(T const* data, std::size_t size)
+  {
+    owned_ = {};
+    data_  = data;
+    size_  = size;
+  }
+
+  std::size_t memory() const { return owned_.capacity() * sizeof(T); }
+
+private:
+  void own()
+  {
+    data_ = owned_.data();
+    size_ = owned_.size();
+  }
+
+  std::vector<T> owned_;
+  T const*       data_{nullptr};
+  std::size_t    size_{0};
+};
+
+// Interned strings, each with the id of the order it was first seen.
+class dictionary {
+public:
+  using id = std::uint32_t;
+
+  static constexpr id none = ~id{0};
+
+  id intern(std::string_view s);
+
+  std::string_view operator[](id i) const
+  {
+    return {text_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]};
+  }
+
+  std::size_t size() const
+  {
+    return offsets_.size() ? (offsets_.size() - 1) : 0;
+  }
+  std::size_t memory() const;
+
+  void save(std::ostream& os) const;
+  void map(char const*& p, char const* end);
+
+private:
+  void rehash(std::size_t size);
+
+  column<char>          text_;
+  column<std::uint64_t> offsets_; // size() + 1 of them, once there is one
+  std::vector<id>       slots_;   // id + 1, 0 is empty; not when mapped
+};
+
+// Strings in order, each stored as the length of the prefix it shares
+// with the one before, then the rest.
+class front_coded {
+public:
+  static constexpr std::size_t restart = 16; // rows between full entries
+
+  void push_back(std::string_view s);
+  void repeat(); // the one before again
+
+  // Entry i, rebuilt in scratch.
+  std::string_view get(std::size_t i, std::string& scratch) const;
+
+  // Replaces value, the entry before at, with the entry at at, and
+  // returns where the one after starts.
+  static char const* next(char const* at, std::string& value);
+
+  char const* first() const { return bytes_.data(); }
+
+  std::size_t memory() const;
+
+  void save(std::ostream& os) const;
+  void map(char const*& p, char const* end, std::size_t size);
+
+private:
+  column<char>          bytes_;
+  column<std::uint64_t> restarts_; // offset of every restart'th entry
+  std::size_t           size_{0};
+  std::string           last_;
+};
+} // namespace detail
+
+class DLL_PUBLIC table {
+public:
+  using id = detail::dictionary::id;
+
+  static constexpr id none = detail::dictionary::none;
+
+  // Where view() puts the parts of a row that are not kept whole.
+  struct buffers {
+    std::string authority;
+    std::string path;
+    std::string query;
+    std::string fragment;
+  };
+
+  // The front coded columns.
+  enum class part : std::uint8_t {
+    path,
+    query,
+    fragment,
+  };
+
+  // Visits one front coded column in row order, rebuilding each entry
+  // from the one before it: the cheap way to read a whole column.
+  class DLL_PUBLIC scanner {
+  public:
+    // The next row's value, or false after the last row.
+    bool next(std::optional<std::string_view>& value);
+
+  private:
+    friend class table;
+
+    scanner(table const& t, part which);
+
+    table const* table_;
+    std::uint8_t present_; // flag for the part
+    char const*  at_;
+    std::size_t  row_{0};
+    std::string  value_;
+  };
+
+  table() = default;
+
+  table(table&&) = default;
+  table& operator=(table&&) = default;
+
+  // Adds the next row.  Throws std::length_error past 2^32 - 1 rows, and
+  // std::runtime_error for a mapped table.
+  void add(uri const& u);
+  void add(components const& parts, form f = form::unnormalized);
+
+  std::size_t size() const { return flags_.size(); }
+
+  // Row i, as parse_*() would have given it, with all of host_type,
+  // port_number and address.
+  component_views view(std::size_t i, buffers& buf) const;
+
+  // Row i, copied.
+  components at(std::size_t i) const;
+
+  bool normalized(std::size_t i) const;
+
+  // Single columns, with no rebuilding.
+  std::optional<std::string_view> scheme(std::size_t i) const;
+  std::optional<std::string_view> host(std::size_t i) const;
+
+  // Rows with the same host have the same id, none for no host.
+  id               host_id(std::size_t i) const { return hosts_[i]; }
+  std::size_t      n_hosts() const { return host_names_.size(); }
+  std::string_view host_name(id host) const { return host_names_[host]; }
+
+  scanner scan(part which) const { return scanner(*this, which); }
+
+  // Bytes held, or mapped.
+  std::size_t memory() const;
+
+  // save() writes the columns as they are in memory, so map() wants a
+  // file from a machine of the same endianness.
+  void         save(std::string const& path) const;
+  static table map(std::string const& path);
+
+private:
+  // Rows with userinfo or a port, which are few.
+  struct extra {
+    std::uint32_t row;
+    id            userinfo;
+    id            port;
+  };
+
+  extra const* find_extra(std::size_t i) const;
+
+  detail::column<std::uint8_t> flags_; // one per row
+  detail::column<id>           schemes_;
+  detail::column<id>           hosts_;
+  detail::column<extra>        extras_;
+
+  detail::dictionary scheme_names_;
+  detail::dictionary host_names_;
+  detail::dictionary userinfos_;
+  detail::dictionary ports_;
+
+  detail::front_coded paths_;
+  detail::front_coded queries_;
+  detail::front_coded fragments_;
+
+  std::shared_ptr<void const> map_; // the file, if mapped
+  std::size_t                 map_size_{0};
+};
+
+} // namespace uri
+
+#endif // TABLE_HPP_INCLUDED
@@ -0,0 +1,640 @@
+#include "alloc_count.hpp"
+#include "binary.hpp"
+#include "router.hpp"
+#include "seen_set.hpp"
+#include "surt.hpp"
+#include "table.hpp"
+#include "uri.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include <gflags/gflags.h>
+namespace gflags {
+// in case we didn't have one
+}
+
+DEFINE_int32(iterations, 100000, "times to run each micro benchmark");
+DEFINE_int32(passes, 20, "times to run through each corpus");
+DEFINE_string(corpus_dir, "bench", "directory holding the corpora");
+DEFINE_bool(json, false, "write one JSON object per line, not a table");
+
+namespace {
+
+// clang-format off
+char const* const IPv6_good[] = {
+  "http://[2001:db8:85a3:8d3:1319:8a2e:370:7348]/",
+  "http://[2001:DB8::7]:8080/",
+  "http://[::ffff:192.0.2.1]/",
+  "http://[fe80::1:2:3:4]/",
+  "http://[::]/",
+  "http://[1:2:3:4:5:6:7::]/",
+};
+
+// These get a long way into the nine alternatives of RFC 3986 before
+// failing, which is the worst case for a backtracking parser.
+char const* const IPv6_bad[] = {
+  "http://[2001:db8:85a3:8d3:1319:8a2e:370:7348:1]/",
+  "http://[1:2:3:4:5:6:7:8:9]/",
+  "http://[1::2::3]/",
+  "http://[1:2:3:4:5:6:1.2.3.256]/",
+  "http://[fe80::1:2:3:4:5:6:7]/",
+  "http://[12345::]/",
+};
+
+struct host_case {
+  char const* host;
+  bool        valid;
+};
+
+// Hyphen runs are what made the PEGTL rules backtrack.
+host_case const hosts[] = {
+  {"example.com",                                                              true},
+  {"www.xn--bcher-kva.example",                                                true},
+  {"a-------------------------------------------------------------b.example",  true},
+  {"a-------------------------------------------------------------.example",   false},
+  {"mail.%65xample%2Ecom",                                                     true},
+  {"b\xC3\xBC" "cher.example",                                                true},
+};
+// clang-format on
+
+// Something like an ad request: forty params.
+std::vector<std::string> const keys = [] {
+  std::vector<std::string> k;
+  for (auto i = 0; i < 40; ++i)
+    k.push_back(fmt::format("param{}", i));
+  return k;
+}();
+
+std::string const query = [] {
+  std::string q;
+  for (auto const& key : keys)
+    q += fmt::format("{}{}=value%20{}", q.empty() ? "" : "&", key, key.size());
+  return q;
+}();
+
+// What one benchmark did: operations, and octets of input if that
+// makes sense.
+struct work {
+  work(long ops_in, long bytes_in = 0)
+    : ops(ops_in)
+    , bytes(bytes_in)
+  {
+  }
+
+  long ops;
+  long bytes;
+};
+
+void report(std::string const& name, work w, long ns, unsigned long allocs)
+{
+  auto const ns_per_op     = double(ns) / w.ops;
+  auto const bytes_per_sec = w.bytes ? 1e9 * w.bytes / ns : 0.0;
+  auto const allocs_per_op = double(allocs) / w.ops;
+
+  if (FLAGS_json) {
+    fmt::print("{{\"name\": \"{}\", \"ops\": {}, \"ns_per_op\": {:.1f}, "
+               "\"bytes_per_sec\": {:.0f}, \"allocs_per_op\": {:.2f}}}\n",
+               name, w.ops, ns_per_op, bytes_per_sec, allocs_per_op);
+    return;
+  }
+  fmt::print("{:<40} {:>10.1f} ns/op", name, ns_per_op);
+  if (w.bytes)
+    fmt::print(" {:>10.1f} MB/s", bytes_per_sec / 1e6);
+  else
+    fmt::print(" {:>10} MB/s", "-");
+  fmt::print(" {:>8.2f} allocs/op\n", allocs_per_op);
+}
+
+// Memory per URI held in name, against a vector of uri.
+void report_memory(std::string const& name, double bytes, double baseline)
+{
+  if (FLAGS_json) {
+    fmt::print("{{\"name\": \"{}\", \"bytes_per_uri\": {:.1f}, "
+               "\"uri_bytes_per_uri\": {:.1f}}}\n",
+               name, bytes, baseline);
+    return;
+  }
+  fmt::print("{:<40} {:>10.1f} B/URI {:>10.1f} B/URI as uri {:>6.1f}x\n",
+             name, bytes, baseline, baseline / bytes);
+}
+
+template <typename Fn>
+void time(std::string const& name, Fn fn)
+{
+  auto const allocs = alloc_count::all();
+  auto const start  = std::chrono::steady_clock::now();
+  work const w      = fn();
+  auto const stop   = std::chrono::steady_clock::now();
+
+  auto const ns
+      = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+  report(name, w, ns.count(), alloc_count::all() - allocs);
+}
+
+// The corpora in bench/ are made up, but shaped like real traffic: one
+// URI (or would-be URI) per line.
+
+// clang-format off
+char const* const corpora[] = {
+  "short_ascii",  // the common case
+  "long_query",   // ad and analytics links, 25 to 60 params
+  "idn",          // UTF-8 and punycode hosts
+  "ipv6",         // IPv6 and IPvFuture literals
+  "dot_segments", // relative references full of . and ..
+  "malformed",    // near misses that have to be rejected
+};
+// clang-format on
+
+std::vector<std::string> load(char const* name)
+{
+  auto const    path = fmt::format("{}/{}.txt", FLAGS_corpus_dir, name);
+  std::ifstream file(path);
+  CHECK(file) << "can't open " << path;
+
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);)
+    lines.push_back(line);
+  return lines;
+}
+
+long bytes_of(std::vector<std::string> const& lines)
+{
+  long bytes = 0;
+  for (auto const& line : lines)
+    bytes += line.size();
+  return bytes;
+}
+
+// The lines for which make() doesn't throw, made.
+template <typename T, typename Make>
+std::vector<T> make_all(std::vector<std::string> const& lines, Make make)
+{
+  std::vector<T> made;
+  for (auto const& line : lines) {
+    try {
+      made.push_back(make(line));
+    }
+    catch (std::exception const&) {
+    }
+  }
+  return made;
+}
+
+// Runs fn over each input, --passes times.
+template <typename T, typename Fn>
+void time_over(std::string const& name,
+               std::vector<T> const& inputs,
+               long                  bytes,
+               Fn                    fn)
+{
+  if (inputs.empty())
+    return;
+  time(name, [&] {
+    for (auto pass = 0; pass < FLAGS_passes; ++pass) {
+      for (auto const& input : inputs)
+        fn(input);
+    }
+    return work(long(inputs.size()) * FLAGS_passes, bytes * FLAGS_passes);
+  });
+}
+
+void bench_corpus(char const* name)
+{
+  auto const lines = load(name);
+  auto const bytes = bytes_of(lines);
+  auto const label = [name](char const* what) {
+    return fmt::format("{}/{}", name, what);
+  };
+
+  time_over(label("parse_generic"), lines, bytes, [](auto const& line) {
+    uri::components parts;
+    uri::parse_generic(line, parts);
+  });
+  time_over(label("parse_relative_ref"), lines, bytes, [](auto const& line) {
+    uri::components parts;
+    uri::parse_relative_ref(line, parts);
+  });
+  time_over(label("parse_reference"), lines, bytes, [](auto const& line) {
+    uri::components parts;
+    uri::parse_reference(line, parts);
+  });
+  time_over(label("parse_absolute"), lines, bytes, [](auto const& line) {
+    uri::components parts;
+    uri::parse_absolute(line, parts);
+  });
+
+  auto const refs = make_all<uri::reference>(
+      lines, [](auto const& line) { return uri::reference{line}; });
+  auto const normal = make_all<uri::reference>(
+      lines, [](auto const& line) { return uri::reference{line, true}; });
+  auto const generics = make_all<uri::generic>(
+      lines, [](auto const& line) { return uri::generic{line}; });
+  auto const absolutes = make_all<uri::absolute>(
+      lines, [](auto const& line) { return uri::absolute{line}; });
+
+  std::vector<std::string> ref_lines;
+  for (auto const& ref : refs)
+    ref_lines.push_back(ref.string());
+  auto const ref_bytes = bytes_of(ref_lines);
+
+  std::vector<std::string>     normal_lines;
+  std::vector<uri::components> normal_parts;
+  for (auto const& line : lines) {
+    uri::components parts;
+    if (!uri::parse_reference(line, parts))
+      continue;
+    try {
+      uri::normalize(parts);
+      normal_lines.push_back(line);
+      normal_parts.push_back(parts);
+    }
+    catch (std::exception const&) {
+    }
+  }
+
+  time_over(label("normalize"), normal_parts, bytes_of(normal_lines),
+            [](auto const& parts) { uri::normalize(parts); });
+
+  time_over(label("reference"), ref_lines, ref_bytes,
+            [](auto const& line) { uri::reference{line}; });
+  time_over(label("reference, normalized"), normal_lines,
+            bytes_of(normal_lines),
+            [](auto const& line) { uri::reference{line, true}; });
+  time_over(label("fingerprint_of(normalize)"), normal_parts,
+            bytes_of(normal_lines), [](auto const& parts) {
+              uri::fingerprint_of(uri::normalize(parts));
+            });
+  time_over(label("canonical_fingerprint"), normal_lines,
+            bytes_of(normal_lines),
+            [](auto const& line) { uri::canonical_fingerprint(line); });
+
+  std::vector<std::string> generic_lines;
+  for (auto const& u : generics)
+    generic_lines.push_back(u.string());
+  time_over(label("generic"), generic_lines, bytes_of(generic_lines),
+            [](auto const& line) { uri::generic{line}; });
+
+  // The same URIs loaded from a file of records instead of parsed.
+  if (!generics.empty()) {
+    uri::binary::writer w;
+    for (auto const& u : generics)
+      w.add(u);
+    auto const path = fmt::format("/tmp/uri-bench-{}.bin", getpid());
+    w.save(path);
+    time(label("binary reader"), [&] {
+      std::size_t hosts = 0;
+      for (auto pass = 0; pass < FLAGS_passes; ++pass) {
+        uri::binary::reader const r(path);
+        for (auto const& rec : r)
+          hosts += rec.host().has_value();
+      }
+      CHECK_LE(hosts, generics.size() * FLAGS_passes);
+      return work(long(generics.size()) * FLAGS_passes,
+                  bytes_of(generic_lines) * FLAGS_passes);
+    });
+    unlink(path.c_str());
+  }
+
+  if (!generics.empty()) {
+    uri::table t;
+    time(label("table, add"), [&] {
+      for (auto const& u : generics)
+        t.add(u);
+      return work(long(generics.size()), bytes_of(generic_lines));
+    });
+    time(label("table, view"), [&] {
+      uri::table::buffers buf;
+      for (auto pass = 0; pass < FLAGS_passes; ++pass) {
+        for (std::size_t i = 0; i < t.size(); ++i)
+          t.view(i, buf);
+      }
+      return work(long(t.size()) * FLAGS_passes,
+                  bytes_of(generic_lines) * FLAGS_passes);
+    });
+
+    auto as_uri = generics.size() * sizeof(uri::uri);
+    for (auto const& u : generics)
+      as_uri += u.string().capacity();
+    report_memory(label("table"), double(t.memory()) / t.size(),
+                  double(as_uri) / t.size());
+  }
+
+  // Sorting by site, against sorting on the whole string.  Each pass
+  // sorts a fresh copy.
+  if (!generics.empty()) {
+    std::string key;
+    time_over(label("surt_key"), generics, bytes_of(generic_lines),
+              [&key](auto const& u) { uri::surt_key(u, key); });
+
+    auto const sort_time = [&](char const* what, auto const& input,
+                               auto sort) {
+      time(label(what), [&] {
+        for (auto pass = 0; pass < FLAGS_passes; ++pass) {
+          auto v = input;
+          sort(v);
+        }
+        return work(long(input.size()) * FLAGS_passes,
+                    bytes_of(generic_lines) * FLAGS_passes);
+      });
+    };
+    sort_time("sort, operator<", generics,
+              [](auto& v) { std::sort(begin(v), end(v)); });
+    sort_time("sort_by_surt", generics,
+              [](auto& v) { uri::sort_by_surt(v); });
+  }
+
+  std::vector<std::string> absolute_lines;
+  for (auto const& u : absolutes)
+    absolute_lines.push_back(u.string());
+  time_over(label("absolute"), absolute_lines, bytes_of(absolute_lines),
+            [](auto const& line) { uri::absolute{line}; });
+
+  // Each with the next: a few are equal, about half are less.
+  if (normal.size() > 1) {
+    time(label("compare"), [&normal] {
+      long n    = 0;
+      long less = 0;
+      for (auto pass = 0; pass < FLAGS_passes; ++pass) {
+        for (size_t i = 1; i < normal.size(); ++i) {
+          less += (normal[i - 1] < normal[i]) + (normal[i - 1] == normal[i]);
+          ++n;
+        }
+      }
+      CHECK_LE(less, 2 * n);
+      return n;
+    });
+  }
+
+  uri::absolute const base{"http://a/b/c/d;p?q"};
+  time_over(label("resolve_ref"), refs, ref_bytes, [&base](auto const& ref) {
+    uri::resolve_ref(base, ref);
+  });
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  { // Need to work with either namespace.
+    using namespace gflags;
+    using namespace google;
+    ParseCommandLineFlags(&argc, &argv, true);
+  }
+
+  for (auto name : corpora)
+    bench_corpus(name);
+
+  time("IPv6 literal", [] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      for (auto u : IPv6_good) {
+        uri::components parts;
+        CHECK(uri::parse_generic(u, parts));
+        ++n;
+      }
+    }
+    return n;
+  });
+
+  time("IPv6 near miss", [] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      for (auto u : IPv6_bad) {
+        uri::components parts;
+        CHECK(!uri::parse_generic(u, parts));
+        ++n;
+      }
+    }
+    return n;
+  });
+
+  time("host name", [] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      for (auto h : hosts) {
+        CHECK_EQ(uri::is_valid_host(h.host), h.valid);
+        ++n;
+      }
+    }
+    return n;
+  });
+
+  time("query, 40 lookups", [] {
+    long        n = 0;
+    std::string bfr;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      uri::query_index const idx{uri::query_view(query)};
+      for (auto const& key : keys) {
+        CHECK(!uri::query_view::decode(*idx.get(key), bfr).empty());
+      }
+      ++n;
+    }
+    return n;
+  });
+
+  time("path segments, 8 deep", [] {
+    uri::generic const u{"https://example.com/api/v2/users/42/orders/7/items/3"};
+    long               n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      uri::path_view const p{u};
+      for (auto seg : p)
+        CHECK(!seg.empty());
+      CHECK_EQ(p.segment(p.size() - 1), "3");
+      ++n;
+    }
+    return n;
+  });
+
+  time("generic, normalized", [] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      uri::generic const u{"HTTP://www.Example.com:80/a/./b/../%7Ec?q=%41#f",
+                           true};
+      ++n;
+    }
+    return n;
+  });
+
+  time("set_query", [] {
+    uri::generic u{"https://www.example.com/landing/page?utm_source=x#top", true};
+    long         n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      u.set_query((i & 1) ? "utm_source=y" : "utm_source=z");
+      ++n;
+    }
+    return n;
+  });
+
+  time("query rebuilt with components", [] {
+    uri::generic u{"https://www.example.com/landing/page?utm_source=x#top", true};
+    long         n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      auto parts  = u.parts();
+      parts.query = (i & 1) ? "utm_source=y" : "utm_source=z";
+      u           = uri::generic(parts, true);
+      ++n;
+    }
+    return n;
+  });
+
+  // Serializing components: the old iostream way and the new ones.
+  auto const parts
+      = uri::generic{"https://user@www.example.com:8443/a/b/c?x=1&y=2#frag"}
+            .parts();
+
+  time("serialize, ostringstream", [&parts] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      std::ostringstream os;
+      os << parts;
+      CHECK(!os.str().empty());
+      ++n;
+    }
+    return n;
+  });
+
+  time("serialize, fmt::format", [&parts] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      CHECK(!fmt::format("{}", parts).empty());
+      ++n;
+    }
+    return n;
+  });
+
+  time("serialize, append_to", [&parts] {
+    long        n = 0;
+    std::string out;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      out.clear();
+      uri::append_to(parts, out);
+      CHECK(!out.empty());
+      ++n;
+    }
+    return n;
+  });
+
+  time("pct_encode, 1k path segment", [] {
+    auto const  raw = std::string(1000, 'x') + "/ ?";
+    std::string out;
+    long        n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      out.resize(uri::encoded_size(raw, uri::encoding::path_segment));
+      uri::pct_encode(raw, uri::encoding::path_segment, out.data());
+      ++n;
+    }
+    return n;
+  });
+
+  // Two thousand hosts on each of a hundred sites, a path for each.
+  uri::router::builder builder;
+  for (auto i = 0u; i < 200'000; ++i) {
+    builder.add(fmt::format("h{}.site{}.example", i % 2'000, i / 2'000),
+                fmt::format("/p{}/q{}", i % 7, i % 13), i);
+  }
+  auto const router = builder.build();
+
+  std::vector<uri::generic> routed;
+  for (auto site = 0; site < 100; ++site) {
+    auto const i = 2'000 * site + 19 * site;
+    routed.emplace_back(fmt::format("http://h{}.site{}.example/p{}/q{}/r",
+                                    i % 2'000, site, i % 7, i % 13));
+  }
+
+  time("router, 200k rules", [&router, &routed] {
+    long n = 0;
+    for (auto i = 0; i < FLAGS_iterations / 100; ++i) {
+      for (auto const& u : routed) {
+        CHECK(router.find(u));
+        ++n;
+      }
+    }
+    return n;
+  });
+
+  std::vector<std::string> crawled;
+  for (auto i = 0; i < 1'000'000; ++i)
+    crawled.push_back(fmt::format("https://www.example.com/item/{}", i));
+  std::vector<std::string_view> crawled_views(crawled.begin(), crawled.end());
+  std::unique_ptr<bool[]>       fresh(new bool[crawled.size()]);
+  uri::seen_set                 seen(crawled.size());
+
+  time("seen_set, 1M bulk inserts", [&] {
+    seen.insert(crawled_views.data(), crawled_views.size(), fresh.get());
+    return long(crawled.size());
+  });
+
+  time("seen_set, 1M bulk lookups", [&] {
+    seen.contains(crawled_views.data(), crawled_views.size(), fresh.get());
+    return long(crawled.size());
+  });
+
+  // The keys of a million URIs on a thousand sites, in no order.
+  std::vector<std::string> surt_keys;
+  for (auto i = 0u; i < 1'000'000; ++i) {
+    auto const j = (i * 7'919u) % 1'000'000;
+    surt_keys.push_back(fmt::format("com,example,site{},www)/item/{}/{}",
+                                    j % 1'000, j % 37, j));
+  }
+
+  auto const sort_keys = [&surt_keys](char const* name, auto sort) {
+    auto keys = surt_keys;
+    time(name, [&keys, sort] {
+      sort(keys);
+      return long(keys.size());
+    });
+    CHECK(std::is_sorted(begin(keys), end(keys)));
+  };
+  sort_keys("1M SURT keys, std::sort",
+            [](auto& keys) { std::sort(begin(keys), end(keys)); });
+  sort_keys("1M SURT keys, radix_sort, 1 thread",
+            [](auto& keys) { uri::radix_sort(keys, 1); });
+  sort_keys("1M SURT keys, radix_sort",
+            [](auto& keys) { uri::radix_sort(keys); });
+
+  // The links on one page: most to the same site, a few elsewhere.
+  uri::absolute const       page{"https://www.example.com/item/500/index.html"};
+  std::vector<uri::generic> links;
+  for (auto i = 0; i < 10'000; ++i) {
+    links.emplace_back((i % 10) ? fmt::format("https://www.example.com/item/{}/"
+                                              "index.html?ref={}",
+                                              i % 1'000, i)
+                                : fmt::format("https://cdn{}.example.net/{}.js",
+                                              i % 3, i));
+  }
+
+  time("append_relative, 10k links", [&page, &links] {
+    std::string packed;
+    std::size_t bytes = 0;
+    for (auto const& link : links) {
+      uri::append_relative(page, link, packed);
+      bytes += link.string().size();
+    }
+    CHECK_LT(packed.size(), bytes);
+    return work(long(links.size()), long(bytes));
+  });
+
+  time("pct_decode, 1k object key", [] {
+    auto const  raw = std::string(1000, 'x') + "%2F%20%3F";
+    std::string out(raw.size(), '\0');
+    long        n = 0;
+    for (auto i = 0; i < FLAGS_iterations; ++i) {
+      CHECK(uri::pct_decode(raw, out.data()));
+      ++n;
+    }
+    return n;
+  });
+}
@@ -0,0 +1,212 @@
+// Runs the grammar over a file of URIs, one per line, and reports for
+// each rule how often it was tried, matched and failed, and how many
+// octets were matched by attempts that went on to fail: the work thrown
+// away by backtracking.
+//
+//   uri-profile [--grammar=reference] [--top=30] file...
+
+#include "uri_internal.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <gflags/gflags.h>
+namespace gflags {
+// in case we didn't have one
+}
+
+DEFINE_string(grammar,
+              "reference",
+              "rule to match each line: URI, absolute, relative or reference");
+DEFINE_int32(top, 30, "number of rules to report");
+
+namespace {
+
+struct rule_stats {
+  std::string name;
+
+  uint64_t attempts{0};
+  uint64_t successes{0};
+  uint64_t failures{0};
+  uint64_t rewound{0}; // octets matched by attempts that then failed
+};
+
+std::deque<rule_stats> rules;
+
+// Rule names as the compiler spells them, less the namespaces, and with
+// the character arguments of one<>, range<> and string<> made readable.
+std::string short_name(std::string name)
+{
+  for (auto ns : {"uri_internal::", "tao::pegtl::abnf::", "tao::pegtl::"}) {
+    for (auto pos = name.find(ns); pos != std::string::npos;
+         pos      = name.find(ns, pos)) {
+      name.erase(pos, strlen(ns));
+    }
+  }
+
+  static std::regex const char_arg{R"(\(char\)(-?\d+))"};
+
+  std::string out;
+  auto        last = name.cbegin();
+  for (std::sregex_iterator it{name.cbegin(), name.cend(), char_arg}, end;
+       it != end; ++it) {
+    out.append(last, (*it)[0].first);
+    auto const ch = static_cast<unsigned char>(std::stoi((*it)[1].str()));
+    if ((' ' < ch) && (ch < 0x7F) && (ch != '\''))
+      out += fmt::format("'{}'", static_cast<char>(ch));
+    else
+      out += fmt::format("'\\x{:02X}'", ch);
+    last = (*it)[0].second;
+  }
+  out.append(last, name.cend());
+  return out;
+}
+
+template <typename Rule>
+rule_stats& stats_for()
+{
+  static rule_stats& stats = rules.emplace_back(
+      rule_stats{short_name(tao::pegtl::internal::demangle<Rule>())});
+  return stats;
+}
+
+// One per rule being matched: where it started, and the furthest any
+// match within it got.
+struct frame {
+  char const* start;
+  char const* high_water;
+};
+
+std::vector<frame> frames;
+
+// Pass how far the attempt got up to the one enclosing it.
+void finish(char const* high_water)
+{
+  frames.pop_back();
+  if (!frames.empty())
+    frames.back().high_water = std::max(frames.back().high_water, high_water);
+}
+
+template <typename Rule>
+struct profile : tao::pegtl::normal<Rule> {
+  template <typename Input, typename... States>
+  static void start(Input const& in, States&&...)
+  {
+    ++stats_for<Rule>().attempts;
+    frames.push_back({in.current(), in.current()});
+  }
+
+  template <typename Input, typename... States>
+  static void success(Input const& in, States&&...)
+  {
+    ++stats_for<Rule>().successes;
+    finish(std::max(frames.back().high_water, in.current()));
+  }
+
+  // Depending on the rule, the input may or may not have been rewound
+  // by now, so the high water mark is what counts.
+  template <typename Input, typename... States>
+  static void failure(Input const& in, States&&...)
+  {
+    auto&      stats      = stats_for<Rule>();
+    auto const high_water = std::max(frames.back().high_water, in.current());
+    ++stats.failures;
+    stats.rewound += high_water - frames.back().start;
+    finish(high_water);
+  }
+};
+
+template <typename Rule>
+bool match(std::string const& line)
+{
+  auto in{tao::pegtl::memory_input<>{line.data(), line.size(), "line"}};
+  return tao::pegtl::parse<Rule, tao::pegtl::nothing, profile>(in);
+}
+
+auto matcher(std::string const& grammar)
+{
+  if (grammar == "URI")
+    return &match<uri_internal::URI_eof>;
+  if (grammar == "absolute")
+    return &match<uri_internal::absolute_URI_eof>;
+  if (grammar == "relative")
+    return &match<uri_internal::relative_ref_eof>;
+  if (grammar == "reference")
+    return &match<uri_internal::URI_reference_eof>;
+  LOG(FATAL) << "unknown --grammar " << grammar;
+  return &match<uri_internal::URI_reference_eof>;
+}
+
+void report(uint64_t lines, uint64_t matched)
+{
+  std::vector<rule_stats const*> ranked;
+  for (auto const& rule : rules)
+    ranked.push_back(&rule);
+  std::sort(begin(ranked), end(ranked), [](auto lhs, auto rhs) {
+    if (lhs->rewound != rhs->rewound)
+      return lhs->rewound > rhs->rewound;
+    return lhs->failures > rhs->failures;
+  });
+  if (ranked.size() > static_cast<size_t>(FLAGS_top))
+    ranked.resize(FLAGS_top);
+
+  fmt::print("{} lines, {} matched {}\n\n", lines, matched, FLAGS_grammar);
+  fmt::print("{:>12} {:>12} {:>12} {:>6} {:>12}  {}\n", "attempts",
+             "successes", "failures", "fail%", "rewound", "rule");
+  for (auto rule : ranked) {
+    auto const fail_pct
+        = rule->attempts ? 100.0 * rule->failures / rule->attempts : 0.0;
+    fmt::print("{:>12} {:>12} {:>12} {:>6.1f} {:>12}  {}\n", rule->attempts,
+               rule->successes, rule->failures, fail_pct, rule->rewound,
+               rule->name);
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  { // Need to work with either namespace.
+    using namespace gflags;
+    using namespace google;
+    ParseCommandLineFlags(&argc, &argv, true);
+  }
+
+  auto const match = matcher(FLAGS_grammar);
+
+  uint64_t lines   = 0;
+  uint64_t matched = 0;
+
+  auto const run = [&](std::istream& is) {
+    for (std::string line; std::getline(is, line);) {
+      ++lines;
+      if (match(line))
+        ++matched;
+      CHECK(frames.empty());
+    }
+  };
+
+  if (argc == 1) {
+    run(std::cin);
+  }
+  for (auto i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i]);
+    if (!file) {
+      LOG(ERROR) << "can't open " << argv[i];
+      return 1;
+    }
+    run(file);
+  }
+
+  report(lines, matched);
+}
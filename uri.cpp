@@ -1,6 +1,13 @@
 #define BUILDING_DLL
 #include "uri.hpp"
 
+#include "fnv1a.hpp"
+#include "grammar.hpp"
+#include "uri_internal.hpp"
+#include "uri_stats.hpp"
+
+#include <charconv>
+#include <cstring>
 #include <iostream>
 #include <utility>
 
@@ -13,35 +20,9 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/split.hpp>
 
-#include <tao/pegtl.hpp>
+#include <glog/logging.h>
 
-using tao::pegtl::any;
-using tao::pegtl::eof;
-using tao::pegtl::list_tail;
 using tao::pegtl::memory_input;
-using tao::pegtl::not_at;
-using tao::pegtl::nothing;
-using tao::pegtl::one;
-using tao::pegtl::opt;
-using tao::pegtl::plus;
-using tao::pegtl::range;
-using tao::pegtl::rep;
-using tao::pegtl::rep_min_max;
-using tao::pegtl::rep_opt;
-using tao::pegtl::seq;
-using tao::pegtl::sor;
-using tao::pegtl::star;
-using tao::pegtl::string;
-using tao::pegtl::success;
-using tao::pegtl::two;
-
-#include <tao/pegtl/contrib/abnf.hpp>
-
-using tao::pegtl::abnf::ALPHA;
-using tao::pegtl::abnf::DIGIT;
-using tao::pegtl::abnf::HEXDIG;
-
-#include <glog/logging.h>
 
 namespace uri {
 class category_impl : public std::error_category {
@@ -62,6 +43,7 @@ std::string category_impl::message(int ev) const
 {
   switch (static_cast<error>(ev)) {
   case error::invalid_syntax: return "unable to parse URI";
+  case error::too_long: return "URI too long for inline storage";
   }
   return "unknown URI error";
 }
@@ -83,283 +65,70 @@ syntax_error::syntax_error()
 }
 
 syntax_error::~syntax_error() noexcept {}
-} // namespace uri
-
-// clang-format off
-namespace uri_internal {
-
-// Rules are from <https://tools.ietf.org/html/rfc3986#appendix-A>
-
-// The order is the rules is mostly reversed here, since we need to
-// define them before use.
-
-// UTF-8 is from RFC-3987
-
-struct UTF8_tail     : range<'\x80', '\xBF'> {};
-
-struct UTF8_1        : range<'\x00', '\x7F'> {};
-
-struct UTF8_2        : seq<range<'\xC2', '\xDF'>, UTF8_tail> {};
-
-struct UTF8_3        : sor<seq<one<'\xE0'>, range<'\xA0', '\xBF'>, UTF8_tail>,
-                           seq<range<'\xE1', '\xEC'>, rep<2, UTF8_tail>>,
-                           seq<one<'\xED'>, range<'\x80', '\x9F'>, UTF8_tail>,
-                           seq<range<'\xEE', '\xEF'>, rep<2, UTF8_tail>>> {};
-
-struct UTF8_4        : sor<seq<one<'\xF0'>, range<'\x90', '\xBF'>, rep<2, UTF8_tail>>,
-                           seq<range<'\xF1', '\xF3'>, rep<3, UTF8_tail>>,
-                           seq<one<'\xF4'>, range<'\x80', '\x8F'>, rep<2, UTF8_tail>>> {};
-
-struct UTF8_non_ascii : sor<UTF8_2, UTF8_3, UTF8_4> {};
-
-//     sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
-//                   / "*" / "+" / "," / ";" / "="
-struct sub_delims    : one<'!', '$', '&', '\'', '(', ')',
-                           '*', '+', ',', ';', '='> {};
-
-//     gen-delims    = ":" / "/" / "?" / "#" / "[" / "]" / "@"
-struct gen_delims    : one<':', '/', '?', '#', '[', ']', '@'> {};
-
-//     reserved      = gen-delims / sub-delims
-struct reserved      : sor<gen_delims, sub_delims> {};
-
-// Allowing UTF-8 in the unreserved rule isn't strictly RFC-3987 since we
-// make no attempt to limit the code points to exaclude the private use
-// areas.  See <https://tools.ietf.org/html/rfc3987>
-
-//    iunreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~" / ucschar
-//     unreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~"
-struct unreserved    : sor<ALPHA, DIGIT, one<'-', '.', '_', '~'>, UTF8_non_ascii> {};
-
-//     pct-encoded   = "%" HEXDIG HEXDIG
-struct pct_encoded   : seq<one<'%'>, HEXDIG, HEXDIG> {};
-
-//     pchar         = unreserved / pct-encoded / sub-delims / ":" / "@"
-struct pchar         : sor<unreserved, pct_encoded, sub_delims, one<':', '@'>> {};
-
-//     fragment      = *( pchar / "/" / "?" )
-struct fragment      : star<sor<pchar, one<'/', '?'>>> {};
-
-//     query         = *( pchar / "/" / "?" )
-struct query         : star<sor<pchar, one<'/', '?'>>> {};
-
-//     segment-nz-nc = 1*( unreserved / pct-encoded / sub-delims / "@" )
-//                   ; non-zero-length segment without any colon ":"
-struct segment_nz_nc : plus<sor<unreserved, pct_encoded, sub_delims, one<'@'>>> {};
-
-//     segment-nz    = 1*pchar
-struct segment_nz    : plus<pchar> {};
-
-//     segment       = *pchar
-struct segment       : star<pchar> {};
 
-// Updated by Errata ID: 2033
-//     path-empty    = ""
-struct path_empty    : success {};
-
-//     path-rootless = segment-nz *( "/" segment )
-struct path_rootless : seq<segment_nz, star<seq<one<'/'>, segment>>> {};
-
-//     path-noscheme = segment-nz-nc *( "/" segment )
-struct path_noscheme : seq<segment_nz_nc, star<seq<one<'/'>, segment>>> {};
-
-//     path-absolute = "/" [ segment-nz *( "/" segment ) ]
-struct path_absolute : seq<one<'/'>, opt<seq<segment_nz, star<seq<one<'/'>, segment>>>>> {};
-
-//     path-abempty  = *( "/" segment )
-struct path_abempty  : star<seq<one<'/'>, segment>> {};
-
-//     path          = path-abempty    ; begins with "/" or is empty
-//                   / path-absolute   ; begins with "/" but not "//"
-//                   / path-noscheme   ; begins with a non-colon segment
-//                   / path-rootless   ; begins with a segment
-//                   / path-empty      ; zero characters
-// struct path       : sor<path_abempty,
-//                         path_absolute,
-//                         path_noscheme,
-//                         path_rootless,
-//                         path_empty> {};
-
-/////////////////////////////////////////////////////////////////////////////
-
-// The definition of reg-name is where I stray from the (very loose)
-// grammar of RFC-3986 and apply the stricter rules of RFC-1123 plus
-// the UTF-8 of RFC-3987.
+length_error::length_error()
+  : std::system_error(make_error_code(error::too_long))
+{
+}
 
-// We allow a very limited set of percent encoded characters in the
-// reg_name part: just letter, digit, hyphen, and dot.  If you want
-// Unicode in your host part, use UTF-8 or punycode: you can't percent
-// encode it.
+length_error::~length_error() noexcept {}
+} // namespace uri
 
-struct pct_let_dig   : seq<one<'%'>,
-                           sor<// ALPHA UC  x41 -> x5A
-                               seq<one<'4'>, range<'1','9'>>,
-                               seq<one<'4'>, range<'A','F'>>,
-                               seq<one<'4'>, range<'a','f'>>,
-                               seq<one<'5'>, range<'0','9'>>,
-                               seq<one<'5'>, one<'A'>>,
-                               seq<one<'5'>, one<'a'>>,
-                               // ALPHA LC  x61 -> x7A
-                               seq<one<'6'>, range<'1','9'>>,
-                               seq<one<'6'>, range<'A','F'>>,
-                               seq<one<'6'>, range<'a','f'>>,
-                               seq<one<'7'>, range<'0','9'>>,
-                               seq<one<'7'>, one<'A'>>,
-                               seq<one<'7'>, one<'a'>>,
-                               // DIGIT     x30 -> x39
-                               seq<one<'3'>, range<'0','9'>>
-                             >
-                           > {};
-
-struct u_let_dig     : sor<ALPHA, DIGIT, UTF8_non_ascii, pct_let_dig> {};
-
-struct dash          : sor<one<'-'>, TAO_PEGTL_ISTRING("%2D")> {};
-
-struct u_ldh_tail    : star<sor<seq<plus<dash>, u_let_dig>, u_let_dig>> {};
-
-struct u_label       : seq<u_let_dig, u_ldh_tail> {};
-
-struct dot           : sor<one<'.'>, TAO_PEGTL_ISTRING("%2E")> {};
-
-// An Internet (RFC-1123) style hostname:
-struct reg_name      : list_tail<u_label, dot> {};
-
-// All that is required for 3986 (as updated by Errata ID: 4942) is the following:
-
-//       reg-name    = *( unreserved / pct-encoded / "-" / "." )
-//struct reg_name    : star<sor<unreserved, pct_encoded, one<'-'>, one<'.'>>> {};
-
-/////////////////////////////////////////////////////////////////////////////
-
-//     dec-octet     = DIGIT                 ; 0-9
-//                   / %x31-39 DIGIT         ; 10-99
-//                   / "1" 2DIGIT            ; 100-199
-//                   / "2" %x30-34 DIGIT     ; 200-249
-//                   / "25" %x30-35          ; 250-255
-struct dec_octet     : sor<seq<string<'2','5'>, range<'0','5'>>,
-                           seq<one<'2'>, range<'0','4'>, DIGIT>,
-                           seq<one<'1'>, DIGIT, DIGIT>,
-                           seq<range<'1','9'>, DIGIT>,
-                           DIGIT> {};
-
-//     IPv4address   = dec-octet "." dec-octet "." dec-octet "." dec-octet
-struct IPv4address   : seq<dec_octet, one<'.'>, dec_octet, one<'.'>, dec_octet, one<'.'>, dec_octet> {};
-struct IPv4address_eof : seq<IPv4address, eof> {};
-
-//     h16           = 1*4HEXDIG
-//                   ; 16 bits of address represented in hexadecimal
-struct h16           : rep_min_max<1, 4, HEXDIG> {};
-
-//     ls32          = ( h16 ":" h16 ) / IPv4address
-//                   ; least-significant 32 bits of address
-struct ls32          : sor<seq<h16, one<':'>, h16>, IPv4address> {};
-
-//     IPv6address   =                            6( h16 ":" ) ls32
-//                   /                       "::" 5( h16 ":" ) ls32
-//                   / [               h16 ] "::" 4( h16 ":" ) ls32
-//                   / [ *1( h16 ":" ) h16 ] "::" 3( h16 ":" ) ls32
-//                   / [ *2( h16 ":" ) h16 ] "::" 2( h16 ":" ) ls32
-//                   / [ *3( h16 ":" ) h16 ] "::"    h16 ":"   ls32
-//                   / [ *4( h16 ":" ) h16 ] "::"              ls32
-//                   / [ *5( h16 ":" ) h16 ] "::"              h16
-//                   / [ *6( h16 ":" ) h16 ] "::"
-
-struct IPv6address   : sor<seq<                                               rep<6, h16, one<':'>>, ls32>,
-                           seq<                                     two<':'>, rep<5, h16, one<':'>>, ls32>,
-                           seq<opt<h16                           >, two<':'>, rep<4, h16, one<':'>>, ls32>,
-                           seq<opt<h16,     opt<   one<':'>, h16>>, two<':'>, rep<3, h16, one<':'>>, ls32>,
-                           seq<opt<h16, rep_opt<2, one<':'>, h16>>, two<':'>, rep<2, h16, one<':'>>, ls32>,
-                           seq<opt<h16, rep_opt<3, one<':'>, h16>>, two<':'>,        h16, one<':'>,  ls32>,
-                           seq<opt<h16, rep_opt<4, one<':'>, h16>>, two<':'>,                        ls32>,
-                           seq<opt<h16, rep_opt<5, one<':'>, h16>>, two<':'>,                        h16>,
-                           seq<opt<h16, rep_opt<6, one<':'>, h16>>, two<':'>>> {};
-
-//     IPvFuture     = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
-struct IPvFuture     : seq<one<'v'>, plus<HEXDIG>, one<'.'>, plus<sor<unreserved, sub_delims, one<':'>>>> {};
-
-//     IP-literal    = "[" ( IPv6address / IPvFuture  ) "]"
-struct IP_literal    : seq<one<'['>, sor<IPv6address, IPvFuture>, one<']'>> {};
-
-// RFC 6874 replaced the above rule with:
-
-//       ZoneID      = 1*( unreserved / pct-encoded )
-//struct ZoneID      : plus<sor<unreserved, pct_encoded>> {};
-
-//       IPv6addrz   = IPv6address "%25" ZoneID
-//struct IPv6addrz   : seq<IPv6address, one<'%'>, ZoneID> {};
-
-//     IP-literal    = "[" ( IPv6address / IPv6addrz / IPvFuture  ) "]"
-
-struct IP_literal_eof: seq<IP_literal, eof> {};
-
-//     port          = *DIGIT
-// But actually, in the IP world, ports are unsigned 16 bit numbers.
-  struct port          : sor<seq<string<'6','5','5','3'>, range<'0','5'>>,
-                             seq<string<'6','5','5'>, range<'0','2'>, DIGIT>,
-                             seq<string<'6','5'>, range<'0', '4'>, rep<2, DIGIT>>,
-                             seq<one<'6'>, range<'0', '4'>, rep<3, DIGIT>>,
-                             seq<range<'0','5'>, rep<4, DIGIT>>,
-                             rep_min_max<0, 4, DIGIT>,
-                             TAO_PEGTL_STRING("00000")
-                             > {};
-
-//     host          = IP-literal / IPv4address / reg-name
-struct host          : sor<IP_literal, IPv4address, reg_name> {};
-
-//     userinfo      = *( unreserved / pct-encoded / sub-delims / ":" )
-struct userinfo      : star<sor<unreserved, pct_encoded, sub_delims, one<':'>>> {};
+namespace uri_internal {
 
-// Use userinfo_at rule to trigger setting userinfo field only after '@' char is found.
-struct userinfo_at   : seq<userinfo, one<'@'>> {};
+// Returns nothing unless port is one or more digits that fit in 16 bits.
+std::optional<uint16_t> port_number(std::string_view port)
+{
+  if (port.empty() || (port.size() > 5))
+    return {};
+  uint32_t p = 0;
+  for (auto ch : port) {
+    if ((ch < '0') || ('9' < ch))
+      return {};
+    p = 10 * p + (ch - '0');
+  }
+  if (p > 0xFFFF)
+    return {};
+  return static_cast<uint16_t>(p);
+}
 
-//     authority     = [ userinfo "@" ] host [ ":" port ]
-struct authority     : seq<opt<userinfo_at>, host, opt<seq<one<':'>, port>>> {};
+// An IPv4address exactly as the grammar has it: four dec-octets with no
+// leading zeros.
+bool IPv4address_bin(std::string_view x, in_addr& addr)
+{
+  auto const bytes = reinterpret_cast<unsigned char*>(&addr.s_addr);
+  auto       s     = begin(x);
+  for (auto i = 0; i < 4; ++i) {
+    if (i && ((s == end(x)) || (*s++ != '.')))
+      return false;
+    auto const first = s;
+    auto       octet = 0u;
+    while ((s != end(x)) && ('0' <= *s) && (*s <= '9') && (s - first < 3))
+      octet = 10 * octet + (*s++ - '0');
+    if ((s == first) || (octet > 255) || ((*first == '0') && (s - first > 1)))
+      return false;
+    bytes[i] = static_cast<unsigned char>(octet);
+  }
+  return s == end(x);
+}
 
-//     scheme        = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
-struct scheme        : seq<ALPHA, star<sor<ALPHA, DIGIT, one<'+', '-', '.'>>>> {};
-
-// Use scheme_colon rule to trigger setting scheme field only after ':' char is found.
-struct scheme_colon  : seq<scheme, one<':'>> {};
-
-//     relative-part = "//" authority path-abempty
-//                   / path-absolute
-//                   / path-noscheme
-//                   / path-abempty    ; this was added in Errata ID: 5428
-//                   / path-empty
-struct relative_part : sor<seq<two<'/'>, authority, path_abempty>,
-                           path_absolute,
-                           path_noscheme,
-                           path_abempty,
-                           path_empty> {};
-
-//     relative-ref  = relative-part [ "?" query ] [ "#" fragment ]
-struct relative_ref  : seq<relative_part, opt<seq<one<'?'>, query>>, opt<seq<one<'#'>, fragment>>> {};
-struct relative_ref_eof : seq<relative_ref, eof> {};
-
-//     hier-part     = "//" authority path-abempty
-//                   / path-absolute
-//                   / path-rootless
-//                   / path-empty
-struct hier_part     : sor<seq<two<'/'>, authority, path_abempty>,
-                           path_absolute,
-                           path_rootless,
-                           path_empty> {};
-
-//     absolute-URI  = scheme ":" hier-part [ "?" query ]
-struct absolute_URI  : seq<scheme_colon, hier_part, opt<seq<one<'?'>, query>>> {};
-struct absolute_URI_eof : seq<absolute_URI, eof> {};
-
-//     URI           = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
-struct URI           : seq<scheme_colon, hier_part, opt<seq<one<'?'>, query>>, opt<seq<one<'#'>, fragment>>> {};
-struct URI_eof       : seq<URI, eof> {};
-
-//     URI-reference = URI / relative-ref
-struct URI_reference : sor<URI, relative_ref> {};
-struct URI_reference_eof : seq<URI_reference, eof> {};
-
-struct path_segment : seq<opt<one<'/'>>, seq<star<not_at<one<'/'>>, not_at<eof>, any>>> {};
-
-// clang-format on
+// Which host rule alternative matches all of host.  For IP addresses,
+// the binary form goes into addr.
+uri::host_kind classify_host(std::string_view host, uri::ip_address& addr)
+{
+  if ((host.size() > 2) && (host.front() == '[') && (host.back() == ']')) {
+    if (host[1] == 'v')
+      return uri::host_kind::IPvFuture;
+    auto const lit   = host.substr(1);
+    auto const bytes = reinterpret_cast<uint8_t*>(&addr.v6);
+    if (uri::grammar::IPv6address(lit, bytes) == lit.size() - 1)
+      return uri::host_kind::IPv6;
+    return uri::host_kind::none;
+  }
+  if (IPv4address_bin(host, addr.v4))
+    return uri::host_kind::IPv4;
+  return uri::host_kind::reg_name;
+}
 
 template <typename Rule>
 struct action : nothing<Rule> {
@@ -367,8 +136,8 @@ struct action : nothing<Rule> {
 
 template <>
 struct action<scheme_colon> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     auto sc = std::string_view(begin(in), size(in));
     CHECK((size(sc) >= 1) && (sc.back() == ':'));
@@ -379,8 +148,8 @@ struct action<scheme_colon> {
 
 template <>
 struct action<authority> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.authority = std::string_view(begin(in), size(in));
   }
@@ -388,8 +157,8 @@ struct action<authority> {
 
 template <>
 struct action<path_abempty> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.path = std::string_view(begin(in), size(in));
   }
@@ -397,17 +166,17 @@ struct action<path_abempty> {
 
 template <>
 struct action<path_empty> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
-    parts.path = std::string{};
+    parts.path = std::string_view(begin(in), 0);
   }
 };
 
 template <>
 struct action<path_absolute> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.path = std::string_view(begin(in), size(in));
   }
@@ -415,8 +184,8 @@ struct action<path_absolute> {
 
 template <>
 struct action<path_rootless> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.path = std::string_view(begin(in), size(in));
   }
@@ -424,8 +193,8 @@ struct action<path_rootless> {
 
 template <>
 struct action<path_noscheme> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.path = std::string_view(begin(in), size(in));
   }
@@ -433,8 +202,8 @@ struct action<path_noscheme> {
 
 template <>
 struct action<query> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.query = std::string_view(begin(in), size(in));
   }
@@ -442,8 +211,8 @@ struct action<query> {
 
 template <>
 struct action<fragment> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     parts.fragment = std::string_view(begin(in), size(in));
   }
@@ -453,8 +222,8 @@ struct action<fragment> {
 
 template <>
 struct action<userinfo_at> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
     auto ui = std::string_view(begin(in), size(in));
     CHECK((size(ui) >= 1) && (ui.back() == '@'));
@@ -465,19 +234,21 @@ struct action<userinfo_at> {
 
 template <>
 struct action<host> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
-    parts.host = std::string_view(begin(in), size(in));
+    parts.host      = std::string_view(begin(in), size(in));
+    parts.host_type = classify_host(*parts.host, parts.address);
   }
 };
 
 template <>
 struct action<port> {
-  template <typename Input>
-  static void apply(Input const& in, uri::components& parts)
+  template <typename Input, typename Parts>
+  static void apply(Input const& in, Parts& parts)
   {
-    parts.port = std::string_view(begin(in), size(in));
+    parts.port        = std::string_view(begin(in), size(in));
+    parts.port_number = port_number(*parts.port);
   }
 };
 
@@ -491,52 +262,138 @@ struct action<path_segment> {
 };
 } // namespace uri_internal
 
-namespace uri {
-DLL_PUBLIC bool parse_generic(std::string_view uri, components& parts)
+namespace uri_internal {
+template <typename Rule, typename Parts>
+bool parse(std::string_view uri, Parts& parts)
 {
+  URI_STATS_TIME(parse);
   auto in{memory_input<>{uri.data(), uri.size(), "uri"}};
-  if (tao::pegtl::parse<uri_internal::URI_eof, uri_internal::action>(in,
-                                                                     parts)) {
+  if (tao::pegtl::parse<Rule, action>(in, parts)) {
     return true;
   }
+  URI_STATS_COUNT(parse_failure);
   return false;
 }
+} // namespace uri_internal
+
+namespace uri {
+DLL_PUBLIC bool parse_generic(std::string_view uri, components& parts)
+{
+  URI_STATS_COUNT(parse_generic);
+  return uri_internal::parse<uri_internal::URI_eof>(uri, parts);
+}
 
 DLL_PUBLIC bool parse_relative_ref(std::string_view uri, components& parts)
 {
-  auto in{memory_input<>{uri.data(), uri.size(), "uri"}};
-  if (tao::pegtl::parse<uri_internal::relative_ref_eof, uri_internal::action>(
-          in, parts)) {
-    return true;
-  }
-  return false;
+  URI_STATS_COUNT(parse_relative_ref);
+  return uri_internal::parse<uri_internal::relative_ref_eof>(uri, parts);
 }
 
 DLL_PUBLIC bool parse_reference(std::string_view uri, components& parts)
 {
-  auto in{memory_input<>{uri.data(), uri.size(), "uri"}};
-  if (tao::pegtl::parse<uri_internal::URI_reference_eof, uri_internal::action>(
-          in, parts)) {
-    return true;
-  }
-  return false;
+  URI_STATS_COUNT(parse_reference);
+  return uri_internal::parse<uri_internal::URI_reference_eof>(uri, parts);
 }
 
 DLL_PUBLIC bool parse_absolute(std::string_view uri, components& parts)
 {
-  auto in{memory_input<>{uri.data(), uri.size(), "uri"}};
-  if (tao::pegtl::parse<uri_internal::absolute_URI_eof, uri_internal::action>(
-          in, parts)) {
-    return true;
+  URI_STATS_COUNT(parse_absolute);
+  return uri_internal::parse<uri_internal::absolute_URI_eof>(uri, parts);
+}
+
+DLL_PUBLIC bool parse_generic(std::string_view uri, component_views& parts)
+{
+  URI_STATS_COUNT(parse_generic);
+  return uri_internal::parse<uri_internal::URI_eof>(uri, parts);
+}
+
+DLL_PUBLIC bool parse_relative_ref(std::string_view uri, component_views& parts)
+{
+  URI_STATS_COUNT(parse_relative_ref);
+  return uri_internal::parse<uri_internal::relative_ref_eof>(uri, parts);
+}
+
+DLL_PUBLIC bool parse_reference(std::string_view uri, component_views& parts)
+{
+  URI_STATS_COUNT(parse_reference);
+  return uri_internal::parse<uri_internal::URI_reference_eof>(uri, parts);
+}
+
+DLL_PUBLIC bool parse_absolute(std::string_view uri, component_views& parts)
+{
+  URI_STATS_COUNT(parse_absolute);
+  return uri_internal::parse<uri_internal::absolute_URI_eof>(uri, parts);
+}
+
+DLL_PUBLIC bool is_valid_host(std::string_view host) noexcept
+{
+  if (host.empty())
+    return false;
+
+  if (host.front() == '[') {
+    auto in{memory_input<>{host.data(), host.size(), "host"}};
+    return tao::pegtl::parse<uri_internal::IP_literal_eof>(in);
   }
-  return false;
+
+  // Every IPv4address is also a reg_name.
+  grammar::reg_name_stats stats;
+  if (grammar::reg_name(host, &stats) != host.size())
+    return false;
+
+  // <https://tools.ietf.org/html/rfc1035#section-2.3.4>, for names
+  // that are already ASCII; the A-labels of a UTF-8 name are checked
+  // by libidn2 when it is converted.
+  return !stats.ascii || ((stats.longest_label <= 63) && (stats.octets <= 253));
+}
+
+namespace {
+// Whether the host_type, port_number and address of components are
+// those a parse of its strings gave, or may be left over from before
+// the strings were changed.
+enum class classified : bool { maybe_stale, by_parse };
+
+components normalize_components(components uri,
+                                classified which = classified::maybe_stale);
 }
 
 std::string to_string(components const& uri)
 {
-  std::ostringstream os;
-  os << uri;
-  return os.str();
+  std::string str;
+  append_to(uri, str);
+  return str;
+}
+
+DLL_PUBLIC std::size_t serialized_size(components const& comp)
+{
+  auto const len = [](std::optional<std::string> const& s) {
+    return s ? s->size() : 0;
+  };
+
+  std::size_t size = 0;
+  if (comp.scheme)
+    size += comp.scheme->size() + 1;
+  if (comp.userinfo || comp.host || comp.port) {
+    size += 2 + len(comp.host);
+    if (comp.userinfo)
+      size += comp.userinfo->size() + 1;
+    if (comp.port)
+      size += comp.port->size() + 1;
+  }
+  else if (comp.authority) {
+    size += 2 + comp.authority->size();
+  }
+  size += len(comp.path);
+  if (comp.query)
+    size += comp.query->size() + 1;
+  if (comp.fragment)
+    size += comp.fragment->size() + 1;
+  return size;
+}
+
+DLL_PUBLIC void append_to(components const& comp, std::string& out)
+{
+  out.reserve(out.size() + serialized_size(comp));
+  append_to(comp, std::back_inserter(out));
 }
 
 bool uri::operator<(uri const& rhs) const
@@ -563,10 +420,9 @@ generic::generic(std::string uri_in, bool norm)
     throw syntax_error();
   }
   if (norm) {
-    uri_   = normalize(parts_);
-    parts_ = components{};
-    CHECK(parse_generic(uri_, parts_));
-    form_ = form::normalized;
+    parts_ = normalize_components(std::move(parts_), classified::by_parse);
+    uri_   = to_string(parts_);
+    form_  = form::normalized;
   }
 }
 
@@ -585,10 +441,9 @@ absolute::absolute(std::string uri_in, bool norm)
     throw syntax_error();
   }
   if (norm) {
-    uri_   = normalize(parts_);
-    parts_ = components{};
-    CHECK(parse_absolute(uri_, parts_));
-    form_ = form::normalized;
+    parts_ = normalize_components(std::move(parts_), classified::by_parse);
+    uri_   = to_string(parts_);
+    form_  = form::normalized;
   }
 }
 
@@ -607,10 +462,9 @@ reference::reference(std::string uri_in, bool norm)
     throw syntax_error();
   }
   if (norm) {
-    uri_   = normalize(parts_);
-    parts_ = components{};
-    CHECK(parse_reference(uri_, parts_));
-    form_ = form::normalized;
+    parts_ = normalize_components(std::move(parts_), classified::by_parse);
+    uri_   = to_string(parts_);
+    form_  = form::normalized;
   }
 }
 
@@ -686,6 +540,8 @@ unsigned char constexpr hexdigit2bin(unsigned char in)
 
 std::string normalize_pct_encoded(std::string_view string)
 {
+  URI_STATS_TIME(normalize_pct_encoded);
+
   fmt::memory_buffer out;
 
   for (auto s = begin(string); s < end(string); ++s) {
@@ -773,6 +629,8 @@ std::string merge(components const& base_parts, components const& ref_parts)
 
 std::string remove_dot_segments(std::string_view input)
 {
+  URI_STATS_TIME(remove_dot_segments);
+
   std::string output;
   output.reserve(input.length());
 
@@ -858,6 +716,8 @@ size_t constexpr max_length = 255;
 
 std::string nfkc(std::string_view str)
 {
+  URI_STATS_TIME(nfkc);
+
   if (str.length() > max_length) {
     throw std::runtime_error("hostname too long");
   }
@@ -871,34 +731,93 @@ std::string nfkc(std::string_view str)
   return std::string{bfr, length};
 }
 
-bool is_IPv4address(std::string_view x)
+// <https://tools.ietf.org/html/rfc5952#section-4>
+
+std::string normalize_IPv6(in6_addr const& addr)
 {
-  auto in{memory_input<>{x.data(), x.size(), "maybe-IPv4address"}};
-  if (tao::pegtl::parse<uri_internal::IPv4address_eof, uri_internal::action>(
-          in)) {
-    return true;
+  uint16_t groups[8];
+  for (auto i = 0; i < 8; ++i) {
+    groups[i] = (addr.s6_addr[2 * i] << 8) | addr.s6_addr[2 * i + 1];
   }
-  return false;
+
+  fmt::memory_buffer out;
+  fmt::format_to(out, "[");
+
+  // 5.  Text Representation of Special Addresses
+  if (IN6_IS_ADDR_V4MAPPED(&addr)) {
+    fmt::format_to(out, "::ffff:{}.{}.{}.{}]", addr.s6_addr[12],
+                   addr.s6_addr[13], addr.s6_addr[14], addr.s6_addr[15]);
+    return fmt::to_string(out);
+  }
+
+  // 4.2.  "::" Usage: the longest run of two or more zero groups, the
+  // first one if there is a tie.
+  auto best = -1, best_len = 1;
+  for (auto i = 0; i < 8;) {
+    if (groups[i]) {
+      ++i;
+      continue;
+    }
+    auto j = i;
+    while ((j < 8) && !groups[j])
+      ++j;
+    if (j - i > best_len) {
+      best     = i;
+      best_len = j - i;
+    }
+    i = j;
+  }
+
+  // 4.1.  Handling Leading Zeros, 4.3.  Lowercase
+  for (auto i = 0; i < 8; ++i) {
+    if (i == best) {
+      fmt::format_to(out, "::");
+      i += best_len - 1;
+      continue;
+    }
+    if (i && (i != best + best_len)) {
+      fmt::format_to(out, ":");
+    }
+    fmt::format_to(out, "{:x}", groups[i]);
+  }
+
+  fmt::format_to(out, "]");
+  return fmt::to_string(out);
 }
 
-bool is_IP_literal(std::string_view x)
+// A host name made of just letters, digits, hyphens and dots, with no
+// A-labels, normalizes to lower case: IDNA would not change it.
+bool is_plain_ascii_host(std::string_view host)
 {
-  auto in{memory_input<>{x.data(), x.size(), "maybe-IP_literal"}};
-  if (tao::pegtl::parse<uri_internal::IP_literal_eof, uri_internal::action>(
-          in)) {
-    return true;
+  for (auto c : host) {
+    if (!(std::isalnum(static_cast<unsigned char>(c)) || (c == '-')
+          || (c == '.')))
+      return false;
   }
-  return false;
+  for (std::size_t label = 0; label < host.size();) {
+    if ((host.size() - label >= 4) && (host[label + 2] == '-')
+        && (host[label + 3] == '-')
+        && (std::tolower(static_cast<unsigned char>(host[label])) == 'x')
+        && (std::tolower(static_cast<unsigned char>(host[label + 1])) == 'n'))
+      return false;
+    auto const dot = host.find('.', label);
+    label          = (dot == std::string_view::npos) ? host.size() : (dot + 1);
+  }
+  return true;
 }
 
 std::string normalize_host(std::string_view host)
 {
+  URI_STATS_TIME(normalize_host);
+
   host = remove_trailing_dot(host);
 
   auto norm_host = normalize_pct_encoded(host);
 
   norm_host = nfkc(norm_host);
 
+  URI_STATS_TIME(idna);
+
   char* ptr  = nullptr;
   auto  code = idn2_to_ascii_8z(norm_host.data(), &ptr, IDN2_TRANSITIONAL);
   if (code != IDN2_OK) {
@@ -925,8 +844,14 @@ std::string normalize_host(std::string_view host)
 
 } // namespace
 
-DLL_PUBLIC std::string normalize(components uri)
+namespace {
+// normalize() without the final to_string(), and with host_type,
+// port_number and address left as a parse of the result would set them.
+components normalize_components(components uri, classified which)
 {
+  URI_STATS_COUNT(normalize);
+  URI_STATS_TIME(normalize);
+
   std::string scheme;
   std::string authority;
   std::string userinfo;
@@ -945,67 +870,61 @@ DLL_PUBLIC std::string normalize(components uri)
     uri.scheme = scheme;
   }
 
+  // Components that did not come straight from the parser are
+  // classified again: a caller may have changed host or port since.
+  if (which != classified::by_parse) {
+    uri.host_type   = host_kind::none;
+    uri.port_number = {};
+  }
+  if (uri.host && (uri.host_type == host_kind::none)) {
+    uri.host_type = uri_internal::classify_host(*uri.host, uri.address);
+  }
+  if (uri.port && !uri.port_number) {
+    uri.port_number = uri_internal::port_number(*uri.port);
+  }
+
   // Normalize the host name.
   if (uri.host) {
-    if (!(is_IPv4address(*uri.host) || is_IP_literal(*uri.host))) {
+    switch (uri.host_type) {
+    case host_kind::none:
+    case host_kind::reg_name:
       host     = normalize_host(*uri.host);
       uri.host = host;
+      break;
+
+    case host_kind::IPv6:
+      host     = normalize_IPv6(uri.address.v6);
+      uri.host = host;
+      break;
+
+    case host_kind::IPv4:
+    case host_kind::IPvFuture: break;
     }
   }
 
   //-----------------------------------------------------------------------------
 
-  // https://url.spec.whatwg.org/#url-miscellaneous
-
-  struct special_scheme {
-    char const* scheme;
-    char const* default_path;
-    uint16_t    default_port;
-  };
-
-  // Very short list of scheme specific default port numbers.
-  // clang-format off
-  special_scheme special[] = {
-      {"ftp",    "",  21},
-      {"gopher", "",  70},
-      {"http",  "/",  80},
-      {"https", "/", 443},
-      {"ws",     "",  80},
-      {"wss",    "", 443},
-  };
-  // clang-format on
-
-  for (auto&& spc : special) {
-    if (uri.scheme == spc.scheme) {
-      if (uri.port && !uri.port->empty()) {
-        auto p = strtoul(uri.port->data(), nullptr, 10);
-        if (p == spc.default_port) {
-          uri.port = {};
-        }
+  if (uri.scheme) {
+    if (auto const spc = find_scheme(*uri.scheme)) {
+      if (spc->default_port && (uri.port_number == spc->default_port)) {
+        uri.port = {};
       }
       if (uri.port && uri.port->empty()) {
         uri.port = {};
       }
 
       if (uri.path && uri.path->empty()) {
-        uri.path = spc.default_path;
+        uri.path = std::string(spc->default_path);
       }
-
-      break;
     }
   }
 
   // remove leading zeros
-  if (uri.port && !uri.port->empty()) {
-    auto p   = strtoul(uri.port->data(), nullptr, 10);
-    port     = fmt::format("{}", p);
+  if (uri.port && uri.port_number) {
+    port     = fmt::format("{}", *uri.port_number);
     uri.port = port;
   }
 
-  // The whole list at:
-  // <https://www.iana.org/assignments/uri-schemes/uri-schemes.xhtml>
-  // has like 288 schemes to deal with, of which 95 are "Permanent."
-
   //-----------------------------------------------------------------------------
 
   // Rebuild authority from user@host:port triple.
@@ -1024,9 +943,13 @@ DLL_PUBLIC std::string normalize(components uri)
     uri.authority = authority;
   }
 
-  // Normalize the path.
+  // Normalize the path.  With no authority, a path that starts "//"
+  // once its dot segments are gone would read as one; a "/." in front
+  // keeps it a path, as RFC 3986 section 5.2.4 suggests.
   if (uri.path) {
-    path     = remove_dot_segments(normalize_pct_encoded(*uri.path));
+    path = remove_dot_segments(normalize_pct_encoded(*uri.path));
+    if (!uri.authority && starts_with(path, "//"))
+      path.insert(0, "/.");
     uri.path = path;
   }
 
@@ -1040,11 +963,641 @@ DLL_PUBLIC std::string normalize(components uri)
     uri.fragment = fragment;
   }
 
-  return to_string(uri);
+  // The normalized host may be of another kind, "%31.2.3.4" is an IPv4
+  // address once decoded.
+  if (uri.host) {
+    uri.host_type = uri_internal::classify_host(*uri.host, uri.address);
+  }
+  if (!uri.port) {
+    uri.port_number = {};
+  }
+
+  return uri;
+}
+} // namespace
+
+DLL_PUBLIC std::string normalize(components uri)
+{
+  return to_string(normalize_components(std::move(uri)));
+}
+
+namespace {
+// Scratch space on the stack for canonical_fingerprint(), which goes
+// the long way for anything bigger.
+constexpr std::size_t max_scheme_length = 64;
+constexpr std::size_t max_path_length   = 2048;
+
+// normalize_pct_encoded(), writing at most string.size() octets to out.
+char* normalize_pct_encoded(std::string_view string, char* out)
+{
+  for (auto s = begin(string); s < end(string); ++s) {
+    auto ch = *s;
+    if (ch == '%') {
+      if ((s + 3 <= end(string)) && ishexdigit(s[1]) && ishexdigit(s[2])) {
+        auto pct_ch = 0x10 * hexdigit2bin(s[1]) + hexdigit2bin(s[2]);
+        if (isunreserved(pct_ch)) {
+          *out++ = char(pct_ch);
+        }
+        else {
+          *out++ = '%';
+          *out++ = "0123456789ABCDEF"[pct_ch >> 4];
+          *out++ = "0123456789ABCDEF"[pct_ch & 0xF];
+        }
+        s += 2;
+        continue;
+      }
+    }
+    *out++ = ch;
+  }
+  return out;
+}
+
+// The same again, into a fingerprinter; runs of octets that need no
+// change go in whole.
+void normalize_pct_encoded(std::string_view string, fingerprinter& f)
+{
+  std::size_t run = 0;
+  for (std::size_t i = 0; i + 3 <= string.size(); ++i) {
+    if ((string[i] == '%') && ishexdigit(string[i + 1])
+        && ishexdigit(string[i + 2])) {
+      char       bfr[3];
+      auto const end = normalize_pct_encoded(string.substr(i, 3), bfr);
+      f.update(string.substr(run, i - run));
+      f.update(std::string_view(bfr, end - bfr));
+      i += 2;
+      run = i + 1;
+    }
+  }
+  f.update(string.substr(run));
+}
+
+// remove_dot_segments() in place, returning the new size.  The output
+// never gets ahead of the input, so the two can share the buffer.
+std::size_t remove_dot_segments(char* path, std::size_t size)
+{
+  auto       in  = path;
+  auto const end = path + size;
+  auto       out = path;
+
+  auto const remove_last_segment = [path, &out] {
+    for (auto p = out; p != path;) {
+      if (*--p == '/') {
+        out = p;
+        return;
+      }
+    }
+  };
+
+  while (in != end) {
+    std::string_view const input(in, end - in);
+
+    // A.
+    if (starts_with(input, "../")) {
+      in += 3;
+      continue;
+    }
+    if (starts_with(input, "./")) {
+      in += 2;
+      continue;
+    }
+
+    // B.  Replacing "/." with "/" is dropping the "." and moving the
+    // "/" up to take its place.
+    if (starts_with(input, "/./")) {
+      in += 2;
+      continue;
+    }
+    if (input == "/.") {
+      in[1] = '/';
+      in += 1;
+      continue;
+    }
+
+    // C.
+    if (starts_with(input, "/../")) {
+      in += 3;
+      remove_last_segment();
+      continue;
+    }
+    if (input == "/..") {
+      in[2] = '/';
+      in += 2;
+      remove_last_segment();
+      continue;
+    }
+
+    // D.
+    if ((input == ".") || (input == "..")) {
+      in = end;
+      continue;
+    }
+
+    // E.  Move the first path segment, with its leading "/" if any.
+    auto segment = in + (*in == '/');
+    while ((segment != end) && (*segment != '/'))
+      ++segment;
+    std::memmove(out, in, segment - in);
+    out += segment - in;
+    in = segment;
+  }
+
+  return out - path;
+}
+
+// A host IDNA leaves as it is, but for case: letters, digits and
+// hyphens in labels that fit the DNS and could not be A-labels.
+bool is_ldh_host(std::string_view host)
+{
+  if ((host.size() > 253) || !is_plain_ascii_host(host))
+    return false;
+  for (std::size_t label = 0; label <= host.size();) {
+    auto dot = host.find('.', label);
+    if (dot == std::string_view::npos)
+      dot = host.size();
+    auto const n = dot - label;
+    if ((n == 0) || (n > 63) || (host[label] == '-') || (host[dot - 1] == '-')
+        || ((n >= 4) && (host[label + 2] == '-') && (host[label + 3] == '-')))
+      return false;
+    label = dot + 1;
+  }
+  return true;
+}
+
+// canonical_fingerprint() for the URIs it can do without allocating.
+std::optional<fingerprint> fingerprint_components(component_views const& parts)
+{
+  fingerprinter f;
+
+  char             scheme_bfr[max_scheme_length];
+  std::string_view scheme;
+  if (parts.scheme) {
+    if (parts.scheme->size() > sizeof(scheme_bfr))
+      return {};
+    std::transform(begin(*parts.scheme), end(*parts.scheme), scheme_bfr,
+                   [](unsigned char c) { return std::tolower(c); });
+    scheme = std::string_view(scheme_bfr, parts.scheme->size());
+  }
+  auto const spc = parts.scheme ? find_scheme(scheme) : nullptr;
+
+  std::string_view host;
+  bool             lower_case_host = false;
+  std::string      ipv6;
+  if (parts.host) {
+    switch (parts.host_type) {
+    case host_kind::none:
+    case host_kind::reg_name:
+      host = remove_trailing_dot(*parts.host);
+      if (!host.empty() && !is_ldh_host(host))
+        return {};
+      lower_case_host = true;
+      break;
+
+    case host_kind::IPv6:
+      ipv6 = normalize_IPv6(parts.address.v6);
+      host = ipv6;
+      break;
+
+    case host_kind::IPv4:
+    case host_kind::IPvFuture: host = *parts.host; break;
+    }
+  }
+
+  auto port = parts.port;
+  auto path = parts.path;
+  if (spc) {
+    if (spc->default_port && (parts.port_number == spc->default_port))
+      port = {};
+    if (port && port->empty())
+      port = {};
+    if (path && path->empty())
+      path = spc->default_path;
+  }
+
+  // remove leading zeros
+  char port_bfr[8];
+  if (port && parts.port_number) {
+    auto const end = std::to_chars(port_bfr, port_bfr + sizeof(port_bfr),
+                                   *parts.port_number);
+    port           = std::string_view(port_bfr, end.ptr - port_bfr);
+  }
+
+  char path_bfr[max_path_length];
+  if (path) {
+    if (path->size() > sizeof(path_bfr))
+      return {};
+    auto const end  = normalize_pct_encoded(*path, path_bfr);
+    auto const size = remove_dot_segments(path_bfr, end - path_bfr);
+    path            = std::string_view(path_bfr, size);
+  }
+
+  // As append_to() puts the normalized components together.
+  if (parts.scheme) {
+    f.update(scheme);
+    f.update(':');
+  }
+  if (parts.userinfo || parts.host || port) {
+    f.update("//");
+    if (parts.userinfo) {
+      f.update(*parts.userinfo);
+      f.update('@');
+    }
+    if (lower_case_host) {
+      for (unsigned char c : host)
+        f.update(char(std::tolower(c)));
+    }
+    else {
+      f.update(host);
+    }
+    if (port) {
+      f.update(':');
+      f.update(*port);
+    }
+  }
+  if (path) {
+    if (!(parts.userinfo || parts.host || port) && starts_with(*path, "//"))
+      f.update("/.");
+    f.update(*path);
+  }
+  if (parts.query) {
+    f.update('?');
+    normalize_pct_encoded(*parts.query, f);
+  }
+  if (parts.fragment) {
+    f.update('#');
+    normalize_pct_encoded(*parts.fragment, f);
+  }
+
+  return f.digest();
+}
+} // namespace
+
+DLL_PUBLIC fingerprint canonical_fingerprint(std::string_view uri)
+{
+  component_views views;
+  if (!parse_reference(uri, views))
+    throw syntax_error();
+  if (auto const fp = fingerprint_components(views))
+    return *fp;
+
+  components parts;
+  parse_reference(uri, parts);
+  return fingerprint_of(normalize(std::move(parts)));
+}
+
+DLL_PUBLIC void surt_key(uri const& u, std::string& key)
+{
+  auto const& parts = u.parts();
+  auto const  lower = [](unsigned char c) { return char(std::tolower(c)); };
+
+  key.clear();
+  if (parts.host) {
+    std::string_view host  = *parts.host;
+    auto const       start = key.size();
+    if ((parts.host_type == host_kind::reg_name)
+        || (parts.host_type == host_kind::none)) {
+      // "www.example.com." as "com,example,www".
+      if (!host.empty() && (host.back() == '.'))
+        host.remove_suffix(1);
+      for (auto end = host.size();;) {
+        auto const dot = host.rfind('.', end ? (end - 1) : 0);
+        auto const first
+            = ((dot == std::string_view::npos) || (dot >= end)) ? 0 : dot + 1;
+        key.append(host.substr(first, end - first));
+        if (first == 0)
+          break;
+        key += ',';
+        end = first - 1;
+      }
+    }
+    else {
+      key.append(host);
+    }
+    if (!u.normalized())
+      std::transform(begin(key) + start, end(key), begin(key) + start, lower);
+
+    if (parts.port && !parts.port->empty()) {
+      auto const spc = parts.scheme ? find_scheme(*parts.scheme) : nullptr;
+      if (!spc || (spc->default_port != parts.port_number)) {
+        key += ':';
+        if (parts.port_number) {
+          char       bfr[8];
+          auto const res = std::to_chars(bfr, bfr + sizeof(bfr),
+                                         *parts.port_number);
+          key.append(bfr, res.ptr);
+        }
+        else {
+          key.append(*parts.port);
+        }
+      }
+    }
+    key += ')';
+  }
+  else if (parts.scheme) {
+    for (auto ch : *parts.scheme)
+      key += lower(ch);
+    key += ':';
+  }
+
+  auto const append_normalized = [&key, &u](std::string_view s) {
+    auto const start = key.size();
+    key.append(s);
+    if (u.normalized())
+      return start;
+    auto const end = normalize_pct_encoded(s, key.data() + start);
+    key.resize(end - key.data());
+    return start;
+  };
+
+  if (parts.host && (!parts.path || parts.path->empty())) {
+    key += '/';
+  }
+  else if (parts.path) {
+    auto const start = append_normalized(*parts.path);
+    if (!u.normalized())
+      key.resize(start + remove_dot_segments(key.data() + start,
+                                             key.size() - start));
+  }
+  if (parts.query) {
+    key += '?';
+    append_normalized(*parts.query);
+  }
+}
+
+DLL_PUBLIC std::string surt_key(uri const& u)
+{
+  std::string key;
+  surt_key(u, key);
+  return key;
+}
+
+namespace {
+template <typename Rule>
+bool matches(std::string_view component)
+{
+  auto in{memory_input<>{component.data(), component.size(), "component"}};
+  return tao::pegtl::parse<Rule>(in);
+}
+
+// Where the authority, without its "//", starts in the URI string; if
+// there is no authority this is where the "//" would go.
+std::size_t authority_offset(components const& parts)
+{
+  auto const scheme = parts.scheme ? (parts.scheme->size() + 1) : 0;
+  return scheme + (parts.authority ? 2 : 0);
+}
+
+std::size_t path_offset(components const& parts)
+{
+  auto const authority = parts.authority ? parts.authority->size() : 0;
+  return authority_offset(parts) + authority;
+}
+
+// Where the "?" is, or would go.
+std::size_t query_offset(components const& parts)
+{
+  return path_offset(parts) + (parts.path ? parts.path->size() : 0);
+}
+
+} // namespace
+
+void uri::set_path(std::string_view path)
+{
+  // The rule depends on what comes before the path.
+  bool ok;
+  if (parts_.authority)
+    ok = matches<uri_internal::path_abempty_eof>(path);
+  else if (parts_.scheme)
+    ok = matches<uri_internal::path_hier_eof>(path);
+  else
+    ok = matches<uri_internal::path_rel_eof>(path);
+  if (!ok)
+    throw syntax_error();
+
+  std::string norm;
+  if (form_ == form::normalized) {
+    norm = remove_dot_segments(normalize_pct_encoded(path));
+    if (norm.empty() && parts_.scheme) {
+      if (auto const spc = find_scheme(*parts_.scheme))
+        norm = spc->default_path;
+    }
+    if (!parts_.authority && starts_with(norm, "//"))
+      norm.insert(0, "/.");
+    path = norm;
+  }
+
+  auto const old = parts_.path ? parts_.path->size() : 0;
+  uri_.replace(path_offset(parts_), old, path);
+  parts_.path = std::string(path);
+}
+
+void uri::set_query(std::optional<std::string_view> query)
+{
+  auto const pos = query_offset(parts_);
+  auto const old = parts_.query ? (parts_.query->size() + 1) : 0;
+
+  if (!query) {
+    uri_.erase(pos, old);
+    parts_.query = {};
+    return;
+  }
+
+  if (!matches<uri_internal::query_eof>(*query))
+    throw syntax_error();
+
+  std::string norm;
+  if (form_ == form::normalized) {
+    norm  = normalize_pct_encoded(*query);
+    query = norm;
+  }
+
+  uri_.replace(pos, old, fmt::format("?{}", *query));
+  parts_.query = std::string(*query);
+}
+
+void uri::set_host(std::string_view host)
+{
+  if (!matches<uri_internal::host_eof>(host))
+    throw syntax_error();
+
+  // An authority can only be followed by an empty or absolute path.
+  if (!parts_.authority && parts_.path && !parts_.path->empty()
+      && (parts_.path->front() != '/'))
+    throw syntax_error();
+
+  ip_address address{};
+  auto       type = uri_internal::classify_host(host, address);
+
+  std::string norm;
+  if (form_ == form::normalized) {
+    switch (type) {
+    case host_kind::none:
+    case host_kind::reg_name:
+      // The same as normalize_host(), without IDNA for the common case
+      // of a name it would only lower-case.
+      if (auto const name = remove_trailing_dot(host);
+          name.empty() || is_ldh_host(name)) {
+        std::transform(begin(name), end(name), std::back_inserter(norm),
+                       [](unsigned char c) { return std::tolower(c); });
+      }
+      else {
+        norm = normalize_host(host);
+      }
+      host = norm;
+      break;
+
+    case host_kind::IPv6:
+      norm = normalize_IPv6(address.v6);
+      host = norm;
+      break;
+
+    case host_kind::IPv4:
+    case host_kind::IPvFuture: break;
+    }
+
+    // As in normalize_components(), "%31.2.3.4" is an IPv4 address once
+    // decoded.
+    type = uri_internal::classify_host(host, address);
+  }
+
+  auto const pos = authority_offset(parts_);
+  if (parts_.authority) {
+    auto const user = parts_.userinfo ? (parts_.userinfo->size() + 1) : 0;
+    auto const old  = parts_.host ? parts_.host->size() : 0;
+    uri_.replace(pos + user, old, host);
+  }
+  else {
+    uri_.insert(pos, fmt::format("//{}", host));
+  }
+
+  parts_.host      = std::string(host);
+  parts_.host_type = type;
+  parts_.address   = address;
+
+  std::string authority;
+  if (parts_.userinfo)
+    authority += fmt::format("{}@", *parts_.userinfo);
+  authority += host;
+  if (parts_.port)
+    authority += fmt::format(":{}", *parts_.port);
+  parts_.authority = authority;
+}
+
+query_view::query_view(uri const& u)
+{
+  // Neither "?" nor "#" can come before the query, and a "#" can only
+  // start the fragment.
+  std::string_view const str = u.string();
+  auto const             end = std::min(str.find('#'), str.size());
+  auto const             q   = str.substr(0, end).find('?');
+  if (q != std::string_view::npos)
+    query_ = str.substr(q + 1, end - (q + 1));
+}
+
+path_view::path_view(uri const& u)
+{
+  // The path follows any scheme ":" and any "//" authority.
+  auto const& parts = u.parts();
+  std::size_t pos   = 0;
+  if (parts.scheme)
+    pos += parts.scheme->size() + 1;
+  if (parts.authority)
+    pos += 2 + parts.authority->size();
+  auto const len = parts.path ? parts.path->size() : 0;
+  path_          = std::string_view(u.string()).substr(pos, len);
+}
+
+std::string_view path_view::segment(std::size_t i) const
+{
+  if (starts_.empty()) {
+    starts_.reserve(size() + 1);
+    for (auto it = begin(); it != end(); ++it) {
+      auto const start = (*it).data() - path_.data();
+      starts_.push_back(static_cast<std::uint32_t>(start));
+    }
+    starts_.push_back(static_cast<std::uint32_t>(path_.size() + 1));
+  }
+  CHECK_LT(i + 1, starts_.size());
+  return path_.substr(starts_[i], starts_[i + 1] - starts_[i] - 1);
+}
+
+std::vector<std::string_view> path_view::remove_dot_segments() const
+{
+  std::vector<std::string_view> out;
+  out.reserve(size());
+  for (auto it = begin(); it != end();) {
+    auto const seg  = *it;
+    auto const last = (++it == end());
+    if ((seg == ".") || (seg == "..")) {
+      if ((seg == "..") && !out.empty())
+        out.pop_back();
+      // "a/b/." is "a/b/", ending with an empty segment
+      if (last && (is_absolute() || !out.empty()))
+        out.push_back(path_.substr(path_.size()));
+      continue;
+    }
+    out.push_back(seg);
+  }
+  return out;
+}
+
+std::optional<std::string_view> query_view::find(std::string_view key) const
+{
+  for (auto const& p : *this) {
+    if (p.key == key)
+      return p.value;
+  }
+  return {};
+}
+
+std::string_view query_view::decode(std::string_view raw, std::string& buffer)
+{
+  if (raw.find_first_of("%+") == std::string_view::npos)
+    return raw;
+
+  // "+" first, so a "%2B" stays a "+".
+  buffer.assign(raw.data(), raw.size());
+  std::replace(buffer.begin(), buffer.end(), '+', ' ');
+  pct_decode_in_place(buffer, decoding::lenient);
+  return buffer;
+}
+
+query_index::query_index(query_view query)
+{
+  params_.reserve(std::distance(query.begin(), query.end()));
+  for (auto const& p : query)
+    params_.push_back(p);
+
+  std::size_t size = 8;
+  while (size < 2 * params_.size())
+    size *= 2;
+  slots_.assign(size, 0);
+
+  // Linear probing keeps the first of any repeated key first in line.
+  for (std::size_t n = 0; n < params_.size(); ++n) {
+    auto i = uri_internal::fnv1a(params_[n].key) & (size - 1);
+    while (slots_[i])
+      i = (i + 1) & (size - 1);
+    slots_[i] = static_cast<std::uint32_t>(n + 1);
+  }
+}
+
+std::optional<std::string_view> query_index::get(std::string_view key) const
+{
+  auto const mask = slots_.size() - 1;
+  auto       i    = uri_internal::fnv1a(key) & mask;
+  for (; slots_[i]; i = (i + 1) & mask) {
+    auto const& p = params_[slots_[i] - 1];
+    if (p.key == key)
+      return p.value;
+  }
+  return {};
 }
 
 DLL_PUBLIC uri resolve_ref(absolute const& base, reference const& ref)
 {
+  URI_STATS_COUNT(resolve_ref);
+  URI_STATS_TIME(resolve_ref);
+
   std::string path;
 
   // 5.2.  Relative Resolution
@@ -1109,6 +1662,7 @@ DLL_PUBLIC uri resolve_ref(absolute const& base, reference const& ref)
         else {
           // T.path = merge(Base.path, R.path);
           // T.path = remove_dot_segments(T.path);
+          URI_STATS_COUNT(resolve_merge);
           path              = remove_dot_segments(merge(base_parts, ref_parts));
           target_parts.path = path;
         }
@@ -1133,50 +1687,193 @@ DLL_PUBLIC uri resolve_ref(absolute const& base, reference const& ref)
   return generic(target_parts);
 }
 
-} // namespace uri
+namespace {
+// The part of base's path that merge() keeps: everything up to the
+// last "/", or just "/".
+std::string_view base_directory(components const& base_parts)
+{
+  std::string_view const path
+      = base_parts.path ? *base_parts.path : std::string_view{};
+  if ((base_parts.authority && path.empty()) || ends_with(path, "/.."))
+    return "/";
+  auto const slash = path.rfind('/');
+  return (slash == std::string_view::npos) ? std::string_view{}
+                                           : path.substr(0, slash + 1);
+}
 
-// <https://tools.ietf.org/html/rfc3986#section-5.3>
+// A relative-path reference to path from the directory dir: some "../"
+// to climb to the directory the two share, then the rest of path.
+struct relative_path {
+  std::size_t      ups{0};
+  std::string_view rest;
+  bool             dot{false}; // "./" first, so rest isn't misread
 
-// 5.3.  Component Recomposition
+  std::size_t size() const
+  {
+    if (rest.empty())
+      return ups ? (3 * ups - 1) : 1; // ".." or "."
+    return 3 * ups + (dot ? 2 : 0) + rest.size();
+  }
 
-DLL_PUBLIC std::ostream& operator<<(std::ostream&          os,
-                                    uri::components const& uri)
-{
-  if (uri.scheme) {
-    os << *uri.scheme << ':';
+  void append_to(std::string& out) const
+  {
+    if (rest.empty()) {
+      if (ups == 0) {
+        out += '.';
+        return;
+      }
+      for (auto i = ups; i > 1; --i)
+        out += "../";
+      out += "..";
+      return;
+    }
+    for (auto i = ups; i; --i)
+      out += "../";
+    if (dot)
+      out += "./";
+    out += rest;
   }
+};
 
-  // The individual parts take precedence over the single authority.
+std::optional<relative_path> make_relative_path(std::string_view dir,
+                                                std::string_view path)
+{
+  if (path.empty())
+    return {}; // a reference with an empty path is the base's path
 
-  if (uri.userinfo || uri.host || uri.port) {
-    os << "//";
+  relative_path rel;
+  if (starts_with(path, dir)) {
+    rel.rest = path.substr(dir.size());
+  }
+  else {
+    // merge() and remove_dot_segments() can't climb a rootless path.
+    if ((dir.empty() || (dir[0] != '/')) || (path[0] != '/'))
+      return {};
+    auto const mismatch = std::mismatch(dir.begin(), dir.end(), path.begin(),
+                                        path.end())
+                              .first
+                          - dir.begin();
+    auto const common = dir.rfind('/', mismatch - 1) + 1;
+    rel.ups  = std::count(dir.begin() + common, dir.end(), '/');
+    rel.rest = path.substr(common);
+  }
 
-    if (uri.userinfo)
-      os << *uri.userinfo << '@';
+  // A first segment with a ":" would be a scheme, and one that starts
+  // with "/" an absolute path or an authority.
+  if (rel.ups == 0) {
+    auto const segment = rel.rest.substr(0, rel.rest.find('/'));
+    rel.dot = (segment.find(':') != std::string_view::npos)
+              || starts_with(rel.rest, "/");
+  }
+  return rel;
+}
+} // namespace
 
-    // Host is never undefined, but perhaps zero length.
-    if (uri.host)
-      os << *uri.host;
+DLL_PUBLIC void
+append_relative(absolute const& base, uri const& target, std::string& out)
+{
+  auto const& base_parts   = base.parts();
+  auto const& target_parts = target.parts();
 
-    if (uri.port)
-      os << ':' << *uri.port;
-  }
-  else if (uri.authority) {
-    os << "//" << *uri.authority;
+  auto const append_query_fragment = [&out, &target_parts] {
+    if (target_parts.query) {
+      out += '?';
+      out += *target_parts.query;
+    }
+    if (target_parts.fragment) {
+      out += '#';
+      out += *target_parts.fragment;
+    }
+  };
+
+  // A different scheme, or an authority to take away, needs the whole.
+  if (!target_parts.scheme || (target_parts.scheme != base_parts.scheme)
+      || (!target_parts.authority && base_parts.authority)) {
+    out += target.string();
+    return;
   }
 
-  if (uri.path) {
-    os << *uri.path;
+  std::string_view const path
+      = target_parts.path ? *target_parts.path : std::string_view{};
+
+  // A network-path reference: "//" and all after the scheme.
+  if (target_parts.authority != base_parts.authority) {
+    out += "//";
+    out += *target_parts.authority;
+    out += path;
+    append_query_fragment();
+    return;
   }
 
-  if (uri.query) {
-    os << '?' << *uri.query;
+  std::string_view const base_path
+      = base_parts.path ? *base_parts.path : std::string_view{};
+  if (path == base_path) {
+    if (target_parts.query == base_parts.query) {
+      // Just the fragment, or nothing at all.
+      if (target_parts.fragment) {
+        out += '#';
+        out += *target_parts.fragment;
+      }
+      return;
+    }
+    if (target_parts.query) {
+      append_query_fragment();
+      return;
+    }
+    // Dropping base's query takes a path, as below.
   }
 
-  if (uri.fragment) {
-    os << '#' << *uri.fragment;
+  // The shortest of a relative path, an absolute path, and the network
+  // path a reference with an authority can always fall back on.  On a
+  // tie the absolute path wins.
+  auto const rel = make_relative_path(base_directory(base_parts), path);
+  auto const absolute_ok = starts_with(path, "/") && !starts_with(path, "//");
+
+  auto const network_size = target_parts.authority
+                                ? (2 + target_parts.authority->size()
+                                   + path.size())
+                                : std::string_view::npos;
+  auto const absolute_size
+      = absolute_ok ? path.size() : std::string_view::npos;
+  auto const relative_size = rel ? rel->size() : std::string_view::npos;
+
+  auto const shortest = std::min({network_size, absolute_size, relative_size});
+  if (shortest == std::string_view::npos) {
+    out += target.string();
+    return;
+  }
+  if (shortest == absolute_size) {
+    out += path;
+  }
+  else if (shortest == relative_size) {
+    rel->append_to(out);
+  }
+  else {
+    out += "//";
+    out += *target_parts.authority;
+    out += path;
   }
+  append_query_fragment();
+}
+
+DLL_PUBLIC reference make_relative(absolute const& base, uri const& target)
+{
+  std::string ref;
+  ref.reserve(target.string().size());
+  append_relative(base, target, ref);
+  return reference(std::move(ref));
+}
 
+} // namespace uri
+
+// <https://tools.ietf.org/html/rfc3986#section-5.3>
+
+// 5.3.  Component Recomposition
+
+DLL_PUBLIC std::ostream& operator<<(std::ostream&          os,
+                                    uri::components const& uri)
+{
+  uri::append_to(uri, std::ostreambuf_iterator<char>(os));
   return os;
 }
 
@@ -3,19 +3,31 @@
 
 #include "dll_spec.h"
 
+#include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <netinet/in.h>
 
 #include <boost/operators.hpp>
 
+#include <fmt/format.h>
+
 namespace uri {
 
 enum class error {
   // parser errors
   invalid_syntax = 1,
+
+  // inline_uri errors
+  too_long,
 };
 
 class DLL_PUBLIC syntax_error : public std::system_error {
@@ -24,8 +36,28 @@ public:
   virtual ~syntax_error() noexcept;
 };
 
+class DLL_PUBLIC length_error : public std::system_error {
+public:
+  length_error();
+  virtual ~length_error() noexcept;
+};
+
 const std::error_category& category();
 
+// Which of the alternatives of the host rule matched.
+enum class host_kind : std::uint8_t {
+  none, // no host, or components not filled in by a parser
+  reg_name,
+  IPv4,
+  IPv6,
+  IPvFuture,
+};
+
+union ip_address {
+  in_addr  v4;
+  in6_addr v6;
+};
+
 struct components {
   std::optional<std::string> scheme;
   std::optional<std::string> authority; // further broken down into:
@@ -35,6 +67,27 @@ struct components {
   std::optional<std::string> path;
   std::optional<std::string> query;
   std::optional<std::string> fragment;
+
+  // Filled in by the parser, ignored by to_string().
+  host_kind                    host_type{host_kind::none};
+  std::optional<std::uint16_t> port_number; // if port is not empty
+  ip_address                   address{};   // for IPv4 and IPv6 hosts
+};
+
+// Same as components, but each view points into the parsed string.
+struct component_views {
+  std::optional<std::string_view> scheme;
+  std::optional<std::string_view> authority;
+  std::optional<std::string_view> userinfo;
+  std::optional<std::string_view> host;
+  std::optional<std::string_view> port;
+  std::optional<std::string_view> path;
+  std::optional<std::string_view> query;
+  std::optional<std::string_view> fragment;
+
+  host_kind                    host_type{host_kind::none};
+  std::optional<std::uint16_t> port_number;
+  ip_address                   address{};
 };
 
 DLL_PUBLIC bool parse_generic(std::string_view uri, components& comp);
@@ -42,10 +95,189 @@ DLL_PUBLIC bool parse_relative_ref(std::string_view uri, components& comp);
 DLL_PUBLIC bool parse_reference(std::string_view uri, components& comp);
 DLL_PUBLIC bool parse_absolute(std::string_view uri, components& comp);
 
+DLL_PUBLIC bool parse_generic(std::string_view uri, component_views& comp);
+DLL_PUBLIC bool parse_relative_ref(std::string_view uri, component_views& comp);
+DLL_PUBLIC bool parse_reference(std::string_view uri, component_views& comp);
+DLL_PUBLIC bool parse_absolute(std::string_view uri, component_views& comp);
+
+// A whole host component as parse_*() accept it: IP-literal, IPv4
+// address or reg-name.  An ASCII reg-name must also fit in the DNS:
+// labels up to 63 octets, 253 in all.  Cheap enough to call on every
+// name in a batch; it never allocates.
+DLL_PUBLIC bool is_valid_host(std::string_view host) noexcept;
+
+// Where pct_encode() output is going.  Each allows the octets of the
+// grammar rule it is named for, less any delimiter that would split
+// it: a query_key can't have "&", "=" or "+", a query_value "&" or "+".
+enum class encoding : std::uint8_t {
+  path_segment, // pchar
+  query_key,
+  query_value,
+  fragment,
+  userinfo,
+};
+
+// Percent encoding of raw octets, with upper case hex.  Octets above
+// 0x7F are always encoded; the result is a URI, not an IRI.
+DLL_PUBLIC std::size_t encoded_size(std::string_view raw,
+                                    encoding         ctx) noexcept;
+
+// Writes exactly encoded_size(raw, ctx) chars starting at out, and
+// returns the end.
+DLL_PUBLIC char*
+pct_encode(std::string_view raw, encoding ctx, char* out) noexcept;
+
+DLL_PUBLIC std::string pct_encode(std::string_view raw, encoding ctx);
+
+// What pct_decode() does with a "%" not followed by two hex digits.
+enum class decoding : bool {
+  strict,  // fail
+  lenient, // keep it as it is
+};
+
+// Decodes every "%XX" in in, writing at most in.size() octets starting
+// at out; out may be in.data().  Returns the end of the output, or
+// nullptr for a strict failure.
+DLL_PUBLIC char* pct_decode(std::string_view in,
+                            char*            out,
+                            decoding         mode = decoding::strict) noexcept;
+
+// Throws syntax_error for a strict failure.
+DLL_PUBLIC std::string pct_decode(std::string_view in,
+                                  decoding         mode = decoding::strict);
+
+// Returns false, leaving s unchanged, for a strict failure.
+DLL_PUBLIC bool
+pct_decode_in_place(std::string& s, decoding mode = decoding::strict) noexcept;
+
 DLL_PUBLIC std::string to_string(components const&);
 
+// The length of to_string(comp), for reserving space.
+DLL_PUBLIC std::size_t serialized_size(components const& comp);
+
+// What to_string(comp) returns, written to out.
+template <typename OutputIt>
+OutputIt append_to(components const& comp, OutputIt out)
+{
+  auto const put = [&out](std::string_view s) {
+    out = std::copy(s.begin(), s.end(), out);
+  };
+
+  if (comp.scheme) {
+    put(*comp.scheme);
+    put(":");
+  }
+
+  // The individual parts take precedence over the single authority.
+  if (comp.userinfo || comp.host || comp.port) {
+    put("//");
+    if (comp.userinfo) {
+      put(*comp.userinfo);
+      put("@");
+    }
+    if (comp.host)
+      put(*comp.host);
+    if (comp.port) {
+      put(":");
+      put(*comp.port);
+    }
+  }
+  else if (comp.authority) {
+    put("//");
+    put(*comp.authority);
+  }
+
+  if (comp.path)
+    put(*comp.path);
+
+  if (comp.query) {
+    put("?");
+    put(*comp.query);
+  }
+
+  if (comp.fragment) {
+    put("#");
+    put(*comp.fragment);
+  }
+
+  return out;
+}
+
+// Appends to out, growing it at most once.
+DLL_PUBLIC void append_to(components const& comp, std::string& out);
+
 DLL_PUBLIC std::string normalize(components);
 
+// A 128 bit hash of a normalized URI: MurmurHash3, x64 128 bit variant,
+// seed zero.
+struct fingerprint {
+  std::uint64_t h1;
+  std::uint64_t h2;
+
+  bool operator==(fingerprint const& rhs) const
+  {
+    return (h1 == rhs.h1) && (h2 == rhs.h2);
+  }
+  bool operator!=(fingerprint const& rhs) const { return !(*this == rhs); }
+};
+
+// Hashes octets fed in a piece at a time; the result is the same as for
+// all the pieces at once.
+class DLL_PUBLIC fingerprinter {
+public:
+  void update(std::string_view piece);
+  void update(char ch)
+  {
+    block_[used_++] = ch;
+    if (used_ == sizeof(block_)) {
+      mix(block_);
+      used_ = 0;
+    }
+  }
+
+  fingerprint digest() const;
+
+private:
+  void mix(char const* block); // 16 octets
+
+  std::uint64_t h1_{0};
+  std::uint64_t h2_{0};
+  std::uint64_t length_{0}; // of the blocks mixed in so far
+  char          block_[16];
+  unsigned      used_{0};
+};
+
+DLL_PUBLIC fingerprint fingerprint_of(std::string_view normalized);
+
+// Same as fingerprint_of(normalize(parts)) for the parse_reference() of
+// uri, without making the normalized string: it's fed to the hash as it
+// is worked out.  Hosts that need IDNA, and very long paths, still go by
+// way of normalize().  Throws syntax_error if uri does not parse.
+DLL_PUBLIC fingerprint canonical_fingerprint(std::string_view uri);
+
+// What normalize() knows about a scheme.
+struct scheme_info {
+  enum flag : std::uint8_t {
+    permanent   = 1 << 0, // IANA registration status
+    provisional = 1 << 1,
+    historical  = 1 << 2,
+    special     = 1 << 3, // a WHATWG special scheme
+  };
+
+  std::string_view name;         // lower case
+  std::string_view default_path; // replaces an empty path
+  std::uint16_t    default_port; // zero if none
+  std::uint8_t     flags;
+};
+
+// Case insensitive lookup, nullptr for an unknown scheme.  Built-in
+// schemes are found with a perfect hash made at compile time.
+DLL_PUBLIC scheme_info const* find_scheme(std::string_view name);
+
+// Add (or replace) a scheme.  Meant for start up; lookups running at
+// the same time are safe and do not lock.
+DLL_PUBLIC void register_scheme(scheme_info const& info);
+
 enum class form : bool {
   unnormalized,
   normalized,
@@ -65,6 +297,10 @@ public:
   auto path()      const { return parts_.path; }
   auto query()     const { return parts_.query; }
   auto fragment()  const { return parts_.fragment; }
+
+  auto host_type()   const { return parts_.host_type; }
+  auto port_number() const { return parts_.port_number; }
+  auto address()     const { return parts_.address; }
   // clang-format on
 
   components const& parts() const& { return parts_; }
@@ -74,6 +310,14 @@ public:
   std::string        string() && { return uri_; }
 
   bool empty() const { return uri_.empty(); }
+  bool normalized() const { return form_ == form::normalized; }
+
+  // Replace one component in place.  Only the new text is checked,
+  // against the grammar rule for that component; syntax_error is thrown
+  // if it does not match.  A normalized URI stays normalized.
+  void set_path(std::string_view path);
+  void set_query(std::optional<std::string_view> query); // nullopt removes
+  void set_host(std::string_view host);
 
   bool operator<(uri const& rhs) const;
   bool operator==(uri const& rhs) const;
@@ -89,6 +333,36 @@ protected:
   form        form_{form::unnormalized};
 };
 
+// The SURT form of u, a key that sorts URIs by site: the host's labels
+// last first and comma separated, any port other than the default, a
+// ")", then the path and query.  The scheme, userinfo and fragment are
+// left out, so both of
+//
+//   http://www.example.com/a?b
+//   https://WWW.Example.COM:443/a?b#c
+//
+// give "com,example,www)/a?b".  IP addresses keep their order.  A URI
+// with no host gives its scheme and a ":" in place of the host.
+//
+// The key replaces what was in key, so a buffer kept from one call to
+// the next is allocated just the once.  Unless u is normalized, its
+// host is lower cased and its path and query normalized as they go in;
+// hosts that want IDNA are only lower cased.
+DLL_PUBLIC void        surt_key(uri const& u, std::string& key);
+DLL_PUBLIC std::string surt_key(uri const& u);
+
+// A uri is kept as a string, so these are just copies.
+
+inline std::size_t serialized_size(uri const& u) { return u.string().size(); }
+
+template <typename OutputIt>
+OutputIt append_to(uri const& u, OutputIt out)
+{
+  return std::copy(u.string().begin(), u.string().end(), out);
+}
+
+inline void append_to(uri const& u, std::string& out) { out += u.string(); }
+
 // Derived types add only ctor()s that use different parsers.
 
 class generic : public uri {
@@ -111,10 +385,468 @@ public:
 
 DLL_PUBLIC uri resolve_ref(absolute const& base, reference const& ref);
 
+// The inverse of resolve_ref(): the shortest reference that resolves
+// against base to target.  That's "#fragment", "?query", a path relative
+// to base's directory or from its root, "//authority" and on, or all of
+// target if its scheme differs from base's; whichever is shortest of
+// those that can do it.  Components are compared as they are, so both
+// should be normalized if "HTTP://A/" and "http://a/" are to match.
+// The round trip gives back target itself if its path has no dot
+// segments, which resolve_ref() would remove.
+DLL_PUBLIC reference make_relative(absolute const& base, uri const& target);
+
+// The same reference appended to out, which need only grow: for
+// storing many links to one page in a single buffer.
+DLL_PUBLIC void
+append_relative(absolute const& base, uri const& target, std::string& out);
+
+// The key=value pairs of a query, split at "&" and "=" with no copying:
+// every string_view points into the query itself.  Empty pairs, as in
+// "a=1&&b=2", are skipped.  Keys and values are left encoded; decode()
+// them as needed.
+//
+//   for (auto const& p : uri::query_view(u)) ...
+
+class DLL_PUBLIC query_view {
+public:
+  struct param {
+    std::string_view key;
+    std::string_view value; // empty for "key" and for "key="
+  };
+
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = param;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = param const*;
+    using reference         = param const&;
+
+    iterator() = default;
+
+    reference operator*() const { return param_; }
+    pointer   operator->() const { return &param_; }
+
+    iterator& operator++()
+    {
+      next();
+      return *this;
+    }
+    iterator operator++(int)
+    {
+      auto tmp = *this;
+      next();
+      return tmp;
+    }
+
+    bool operator==(iterator const& rhs) const
+    {
+      return (at_end_ == rhs.at_end_)
+             && (at_end_ || (param_.key.data() == rhs.param_.key.data()));
+    }
+    bool operator!=(iterator const& rhs) const { return !(*this == rhs); }
+
+  private:
+    friend class query_view;
+
+    explicit iterator(std::string_view rest)
+      : rest_(rest)
+      , at_end_(false)
+    {
+      next();
+    }
+
+    void next()
+    {
+      while (!rest_.empty()) {
+        auto const amp  = rest_.find('&');
+        auto const pair = rest_.substr(0, amp);
+        rest_ = (amp == std::string_view::npos) ? std::string_view{}
+                                                : rest_.substr(amp + 1);
+        if (pair.empty())
+          continue;
+        auto const eq = pair.find('=');
+        param_.key    = pair.substr(0, eq);
+        param_.value  = (eq == std::string_view::npos) ? std::string_view{}
+                                                      : pair.substr(eq + 1);
+        return;
+      }
+      at_end_ = true;
+    }
+
+    std::string_view rest_;
+    param            param_;
+    bool             at_end_{true};
+  };
+
+  explicit query_view(std::string_view query)
+    : query_(query)
+  {
+  }
+
+  // The query of u, pointing into u.string(); empty if u has none.
+  explicit query_view(uri const& u);
+
+  iterator begin() const { return iterator(query_); }
+  iterator end() const { return iterator(); }
+
+  bool empty() const { return begin() == end(); }
+
+  // The raw value of the first param named key, by a linear search.
+  // For many lookups on a long query build a query_index.
+  std::optional<std::string_view> find(std::string_view key) const;
+
+  // Decodes "%XX" and "+" in raw.  If there is nothing to decode raw is
+  // returned as is, otherwise the decoded bytes are written to buffer
+  // and the result points there.  A "%" not followed by two hex digits
+  // is kept as it is.
+  static std::string_view decode(std::string_view raw, std::string& buffer);
+
+private:
+  std::string_view query_;
+};
+
+// A flat, open addressed, hash index of the params of a query_view,
+// built with two passes over the query, one to count the params, and
+// two allocations, for O(1) lookups.  Keys are compared as they are written in the query, with
+// no decoding.  The query must outlive the index.
+class DLL_PUBLIC query_index {
+public:
+  explicit query_index(query_view query);
+
+  // Same result as query_view::find().
+  std::optional<std::string_view> get(std::string_view key) const;
+
+  std::size_t size() const { return params_.size(); }
+
+  auto begin() const { return params_.begin(); }
+  auto end() const { return params_.end(); }
+
+private:
+  std::vector<query_view::param> params_;
+  std::vector<std::uint32_t>     slots_; // index + 1 into params_, 0 is empty
+};
+
+// The segments of a path as string_views into it, with no copying.
+// "/a/b/" has the segments "a", "b" and "", so does "a/b/"; "" has
+// none.  Iteration works both ways; segment(i) builds an index of
+// segment offsets the first time it is called, so a path_view is not
+// to be shared between threads.
+//
+//   for (auto seg : uri::path_view(u)) ...
+
+class DLL_PUBLIC path_view {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = std::string_view;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = std::string_view;
+
+    iterator() = default;
+
+    std::string_view operator*() const
+    {
+      return path_.substr(begin_, end_ - begin_);
+    }
+
+    iterator& operator++()
+    {
+      if (end_ == path_.size()) {
+        begin_ = end_ = path_.size() + 1;
+      }
+      else {
+        begin_ = end_ + 1;
+        end_   = std::min(path_.find('/', begin_), path_.size());
+      }
+      return *this;
+    }
+    iterator operator++(int)
+    {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    iterator& operator--()
+    {
+      end_ = (begin_ > path_.size()) ? path_.size() : (begin_ - 1);
+      auto const slash
+          = (end_ > 0) ? path_.rfind('/', end_ - 1) : std::string_view::npos;
+      begin_ = (slash == std::string_view::npos) ? 0 : (slash + 1);
+      return *this;
+    }
+    iterator operator--(int)
+    {
+      auto tmp = *this;
+      --*this;
+      return tmp;
+    }
+
+    bool operator==(iterator const& rhs) const
+    {
+      return (path_.data() == rhs.path_.data()) && (begin_ == rhs.begin_);
+    }
+    bool operator!=(iterator const& rhs) const { return !(*this == rhs); }
+
+  private:
+    friend class path_view;
+
+    iterator(std::string_view path, std::size_t begin)
+      : path_(path)
+      , begin_(begin)
+      , end_(begin)
+    {
+      if (begin_ <= path_.size())
+        end_ = std::min(path_.find('/', begin_), path_.size());
+    }
+
+    std::string_view path_;
+    std::size_t      begin_{0}; // path_.size() + 1 at the end
+    std::size_t      end_{0};
+  };
+
+  using reverse_iterator = std::reverse_iterator<iterator>;
+
+  explicit path_view(std::string_view path)
+    : path_(path)
+  {
+  }
+
+  // The path of u, pointing into u.string().
+  explicit path_view(uri const& u);
+
+  iterator begin() const
+  {
+    if (path_.empty())
+      return end();
+    return iterator(path_, is_absolute() ? 1 : 0);
+  }
+  iterator end() const { return iterator(path_, path_.size() + 1); }
+
+  reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+  bool is_absolute() const { return !path_.empty() && (path_[0] == '/'); }
+
+  bool empty() const { return path_.empty(); }
+
+  // The number of segments, by counting slashes.
+  std::size_t size() const
+  {
+    if (path_.empty())
+      return 0;
+    auto const slashes = std::count(path_.begin(), path_.end(), '/');
+    return slashes + (is_absolute() ? 0 : 1);
+  }
+
+  // Segment i, 0 <= i < size().
+  std::string_view segment(std::size_t i) const;
+
+  // The segments left by RFC 3986 section 5.2.4, still pointing into
+  // the path.  For a path that is not absolute any leading ".." is just
+  // dropped.
+  std::vector<std::string_view> remove_dot_segments() const;
+
+  std::string_view string() const { return path_; }
+
+private:
+  std::string_view                   path_;
+  mutable std::vector<std::uint32_t> starts_; // filled in by segment()
+};
+
+// What inline_uri does with a URI longer than its capacity.
+enum class overflow : bool {
+  error, // throw length_error
+  spill, // keep the bytes on the heap
+};
+
+namespace detail {
+template <std::size_t N, overflow Policy>
+struct inline_storage {
+  char const* data() const { return bfr_; }
+
+  char* allocate(std::size_t n)
+  {
+    if (n > N)
+      throw length_error();
+    return bfr_;
+  }
+
+  char bfr_[N];
+};
+
+template <std::size_t N>
+struct inline_storage<N, overflow::spill> {
+  char const* data() const { return spill_.empty() ? bfr_ : spill_.data(); }
+
+  char* allocate(std::size_t n)
+  {
+    spill_.clear();
+    if (n <= N)
+      return bfr_;
+    spill_.resize(n);
+    return spill_.data();
+  }
+
+  std::string spill_;
+  char        bfr_[N];
+};
+} // namespace detail
+
+// A generic URI that keeps its bytes and the offsets of its components
+// inside the object itself.  With overflow::error it never allocates
+// and is trivially copyable, so it may be memcpy()ed through queues and
+// shared memory.
+
+template <std::size_t N, overflow Policy = overflow::error>
+class inline_uri : boost::operators<inline_uri<N, Policy>>,
+                   detail::inline_storage<N, Policy> {
+  static constexpr bool narrow = (Policy == overflow::error) && (N < 0xFFFF);
+
+  using offset_t = std::conditional_t<narrow, std::uint16_t, std::uint32_t>;
+
+  static constexpr offset_t undefined = ~offset_t{0};
+
+  struct span {
+    offset_t offset{undefined};
+    offset_t length{0};
+  };
+
+public:
+  inline_uri() = default;
+
+  explicit inline_uri(std::string_view uri_in)
+  {
+    auto const bfr = this->allocate(uri_in.size());
+    std::copy(begin(uri_in), end(uri_in), bfr);
+    size_ = static_cast<offset_t>(uri_in.size());
+
+    component_views parts;
+    if (!parse_generic(string(), parts)) {
+      size_ = 0;
+      throw syntax_error();
+    }
+
+    set_(scheme_, parts.scheme);
+    set_(authority_, parts.authority);
+    set_(userinfo_, parts.userinfo);
+    set_(host_, parts.host);
+    set_(port_, parts.port);
+    set_(path_, parts.path);
+    set_(query_, parts.query);
+    set_(fragment_, parts.fragment);
+
+    host_type_ = parts.host_type;
+    if (parts.port_number) {
+      has_port_number_ = true;
+      port_number_     = *parts.port_number;
+    }
+    address_ = parts.address;
+  }
+
+  // clang-format off
+  auto scheme()    const { return get_(scheme_); }
+  auto authority() const { return get_(authority_); }
+  auto userinfo()  const { return get_(userinfo_); }
+  auto host()      const { return get_(host_); }
+  auto port()      const { return get_(port_); }
+  auto path()      const { return get_(path_); }
+  auto query()     const { return get_(query_); }
+  auto fragment()  const { return get_(fragment_); }
+
+  auto host_type()   const { return host_type_; }
+  auto port_number() const { return has_port_number_
+                                    ? std::optional<std::uint16_t>{port_number_}
+                                    : std::nullopt; }
+  auto address()     const { return address_; }
+  // clang-format on
+
+  std::string_view string() const { return {this->data(), size_}; }
+
+  static constexpr std::size_t capacity() { return N; }
+
+  bool empty() const { return size_ == 0; }
+
+  bool operator<(inline_uri const& rhs) const
+  {
+    return string() < rhs.string();
+  }
+  bool operator==(inline_uri const& rhs) const
+  {
+    return string() == rhs.string();
+  }
+
+private:
+  void set_(span& s, std::optional<std::string_view> const& v)
+  {
+    if (v) {
+      s.offset = static_cast<offset_t>(v->data() - this->data());
+      s.length = static_cast<offset_t>(v->size());
+    }
+  }
+
+  std::optional<std::string_view> get_(span const& s) const
+  {
+    if (s.offset == undefined)
+      return {};
+    return std::string_view(this->data() + s.offset, s.length);
+  }
+
+  offset_t size_{0};
+
+  span scheme_;
+  span authority_;
+  span userinfo_;
+  span host_;
+  span port_;
+  span path_;
+  span query_;
+  span fragment_;
+
+  // As in components, but with no std::optional, which need not be
+  // trivially copyable.
+  host_kind     host_type_{host_kind::none};
+  bool          has_port_number_{false};
+  std::uint16_t port_number_{0};
+  ip_address    address_{};
+};
+
 } // namespace uri
 
 DLL_PUBLIC std::ostream& operator<<(std::ostream&          os,
                                     uri::components const& uri);
 DLL_PUBLIC std::ostream& operator<<(std::ostream& os, uri::uri const&);
 
+// fmt::format("{}", u) with no iostream in the way; format specs are
+// those of a string.
+
+namespace fmt {
+template <>
+struct formatter<uri::components> : formatter<string_view> {
+  template <typename FormatContext>
+  auto format(uri::components const& comp, FormatContext& ctx)
+  {
+    memory_buffer bfr;
+    uri::append_to(comp, std::back_inserter(bfr));
+    return formatter<string_view>::format(string_view(bfr.data(), bfr.size()),
+                                          ctx);
+  }
+};
+
+template <typename T>
+struct formatter<T,
+                 char,
+                 std::enable_if_t<std::is_base_of<uri::uri, T>::value>>
+  : formatter<string_view> {
+  template <typename FormatContext>
+  auto format(uri::uri const& u, FormatContext& ctx)
+  {
+    return formatter<string_view>::format(u.string(), ctx);
+  }
+};
+} // namespace fmt
+
 #endif // URI_HPP_INCLUDED
@@ -0,0 +1,340 @@
+#ifndef URI_INTERNAL_HPP_INCLUDED
+#define URI_INTERNAL_HPP_INCLUDED
+
+// The PEGTL grammar behind the parse functions, for uri.cpp and the
+// tools that run it directly, and a few helpers of the parser's that
+// the rest of the library shares.  Not installed: it needs the PEGTL.
+
+#include "grammar.hpp"
+#include "uri.hpp"
+
+#include <tao/pegtl.hpp>
+#include <tao/pegtl/contrib/abnf.hpp>
+
+namespace uri_internal {
+
+using tao::pegtl::any;
+using tao::pegtl::eof;
+using tao::pegtl::list_tail;
+using tao::pegtl::memory_input;
+using tao::pegtl::not_at;
+using tao::pegtl::nothing;
+using tao::pegtl::one;
+using tao::pegtl::opt;
+using tao::pegtl::plus;
+using tao::pegtl::range;
+using tao::pegtl::rep;
+using tao::pegtl::rep_min_max;
+using tao::pegtl::rep_opt;
+using tao::pegtl::seq;
+using tao::pegtl::sor;
+using tao::pegtl::star;
+using tao::pegtl::string;
+using tao::pegtl::success;
+using tao::pegtl::two;
+using tao::pegtl::abnf::ALPHA;
+using tao::pegtl::abnf::DIGIT;
+using tao::pegtl::abnf::HEXDIG;
+
+// clang-format off
+
+// Rules are from <https://tools.ietf.org/html/rfc3986#appendix-A>
+
+// The order is the rules is mostly reversed here, since we need to
+// define them before use.
+
+// UTF-8 is from RFC-3987
+
+struct UTF8_tail     : range<'\x80', '\xBF'> {};
+
+struct UTF8_1        : range<'\x00', '\x7F'> {};
+
+struct UTF8_2        : seq<range<'\xC2', '\xDF'>, UTF8_tail> {};
+
+struct UTF8_3        : sor<seq<one<'\xE0'>, range<'\xA0', '\xBF'>, UTF8_tail>,
+                           seq<range<'\xE1', '\xEC'>, rep<2, UTF8_tail>>,
+                           seq<one<'\xED'>, range<'\x80', '\x9F'>, UTF8_tail>,
+                           seq<range<'\xEE', '\xEF'>, rep<2, UTF8_tail>>> {};
+
+struct UTF8_4        : sor<seq<one<'\xF0'>, range<'\x90', '\xBF'>, rep<2, UTF8_tail>>,
+                           seq<range<'\xF1', '\xF3'>, rep<3, UTF8_tail>>,
+                           seq<one<'\xF4'>, range<'\x80', '\x8F'>, rep<2, UTF8_tail>>> {};
+
+struct UTF8_non_ascii : sor<UTF8_2, UTF8_3, UTF8_4> {};
+
+//     sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
+//                   / "*" / "+" / "," / ";" / "="
+struct sub_delims    : one<'!', '$', '&', '\'', '(', ')',
+                           '*', '+', ',', ';', '='> {};
+
+//     gen-delims    = ":" / "/" / "?" / "#" / "[" / "]" / "@"
+struct gen_delims    : one<':', '/', '?', '#', '[', ']', '@'> {};
+
+//     reserved      = gen-delims / sub-delims
+struct reserved      : sor<gen_delims, sub_delims> {};
+
+// Allowing UTF-8 in the unreserved rule isn't strictly RFC-3987 since we
+// make no attempt to limit the code points to exaclude the private use
+// areas.  See <https://tools.ietf.org/html/rfc3987>
+
+//    iunreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~" / ucschar
+//     unreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~"
+struct unreserved    : sor<ALPHA, DIGIT, one<'-', '.', '_', '~'>, UTF8_non_ascii> {};
+
+//     pct-encoded   = "%" HEXDIG HEXDIG
+struct pct_encoded   : seq<one<'%'>, HEXDIG, HEXDIG> {};
+
+//     pchar         = unreserved / pct-encoded / sub-delims / ":" / "@"
+struct pchar         : sor<unreserved, pct_encoded, sub_delims, one<':', '@'>> {};
+
+//     fragment      = *( pchar / "/" / "?" )
+struct fragment      : star<sor<pchar, one<'/', '?'>>> {};
+
+//     query         = *( pchar / "/" / "?" )
+struct query         : star<sor<pchar, one<'/', '?'>>> {};
+
+//     segment-nz-nc = 1*( unreserved / pct-encoded / sub-delims / "@" )
+//                   ; non-zero-length segment without any colon ":"
+struct segment_nz_nc : plus<sor<unreserved, pct_encoded, sub_delims, one<'@'>>> {};
+
+//     segment-nz    = 1*pchar
+struct segment_nz    : plus<pchar> {};
+
+//     segment       = *pchar
+struct segment       : star<pchar> {};
+
+// Updated by Errata ID: 2033
+//     path-empty    = ""
+struct path_empty    : success {};
+
+//     path-rootless = segment-nz *( "/" segment )
+struct path_rootless : seq<segment_nz, star<seq<one<'/'>, segment>>> {};
+
+//     path-noscheme = segment-nz-nc *( "/" segment )
+struct path_noscheme : seq<segment_nz_nc, star<seq<one<'/'>, segment>>> {};
+
+//     path-absolute = "/" [ segment-nz *( "/" segment ) ]
+struct path_absolute : seq<one<'/'>, opt<seq<segment_nz, star<seq<one<'/'>, segment>>>>> {};
+
+//     path-abempty  = *( "/" segment )
+struct path_abempty  : star<seq<one<'/'>, segment>> {};
+
+//     path          = path-abempty    ; begins with "/" or is empty
+//                   / path-absolute   ; begins with "/" but not "//"
+//                   / path-noscheme   ; begins with a non-colon segment
+//                   / path-rootless   ; begins with a segment
+//                   / path-empty      ; zero characters
+// struct path       : sor<path_abempty,
+//                         path_absolute,
+//                         path_noscheme,
+//                         path_rootless,
+//                         path_empty> {};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The definition of reg-name is where I stray from the (very loose)
+// grammar of RFC-3986 and apply the stricter rules of RFC-1123 plus
+// the UTF-8 of RFC-3987.
+
+// We allow a very limited set of percent encoded characters in the
+// reg_name part: just letter, digit, hyphen, and dot.  If you want
+// Unicode in your host part, use UTF-8 or punycode: you can't percent
+// encode it.
+
+// clang-format on
+
+// The rules are spelled out in grammar.hpp, which matches them with a
+// table lookup per octet rather than a dozen PEGTL alternatives.
+
+// An Internet (RFC-1123) style hostname:
+struct reg_name {
+  using analyze_t = tao::pegtl::analysis::generic<tao::pegtl::analysis::rule_type::ANY>;
+
+  template <tao::pegtl::apply_mode      A,
+            tao::pegtl::rewind_mode     M,
+            template <typename...> class Action,
+            template <typename...> class Control,
+            typename Input,
+            typename... States>
+  static bool match(Input& in, States&&...)
+  {
+    auto const n = uri::grammar::reg_name({in.current(), in.size()});
+    if (n) {
+      in.bump(n);
+      return true;
+    }
+    return false;
+  }
+};
+
+// clang-format off
+
+// All that is required for 3986 (as updated by Errata ID: 4942) is the following:
+
+//       reg-name    = *( unreserved / pct-encoded / "-" / "." )
+//struct reg_name    : star<sor<unreserved, pct_encoded, one<'-'>, one<'.'>>> {};
+
+/////////////////////////////////////////////////////////////////////////////
+
+//     dec-octet     = DIGIT                 ; 0-9
+//                   / %x31-39 DIGIT         ; 10-99
+//                   / "1" 2DIGIT            ; 100-199
+//                   / "2" %x30-34 DIGIT     ; 200-249
+//                   / "25" %x30-35          ; 250-255
+struct dec_octet     : sor<seq<string<'2','5'>, range<'0','5'>>,
+                           seq<one<'2'>, range<'0','4'>, DIGIT>,
+                           seq<one<'1'>, DIGIT, DIGIT>,
+                           seq<range<'1','9'>, DIGIT>,
+                           DIGIT> {};
+
+//     IPv4address   = dec-octet "." dec-octet "." dec-octet "." dec-octet
+struct IPv4address   : seq<dec_octet, one<'.'>, dec_octet, one<'.'>, dec_octet, one<'.'>, dec_octet> {};
+
+//     h16           = 1*4HEXDIG
+//                   ; 16 bits of address represented in hexadecimal
+
+//     ls32          = ( h16 ":" h16 ) / IPv4address
+//                   ; least-significant 32 bits of address
+
+//     IPv6address   =                            6( h16 ":" ) ls32
+//                   /                       "::" 5( h16 ":" ) ls32
+//                   / [               h16 ] "::" 4( h16 ":" ) ls32
+//                   / [ *1( h16 ":" ) h16 ] "::" 3( h16 ":" ) ls32
+//                   / [ *2( h16 ":" ) h16 ] "::" 2( h16 ":" ) ls32
+//                   / [ *3( h16 ":" ) h16 ] "::"    h16 ":"   ls32
+//                   / [ *4( h16 ":" ) h16 ] "::"              ls32
+//                   / [ *5( h16 ":" ) h16 ] "::"              h16
+//                   / [ *6( h16 ":" ) h16 ] "::"
+
+// clang-format on
+
+// The nine alternatives above as PEGTL rules backtrack a lot, mostly on
+// bad input.  This does the same thing in a single pass, and leaves the
+// binary address for the action on host.
+struct IPv6address {
+  using analyze_t = tao::pegtl::analysis::generic<tao::pegtl::analysis::rule_type::ANY>;
+
+  template <tao::pegtl::apply_mode      A,
+            tao::pegtl::rewind_mode     M,
+            template <typename...> class Action,
+            template <typename...> class Control,
+            typename Input,
+            typename... States>
+  static bool match(Input& in, States&&...)
+  {
+    uint8_t    addr[16];
+    auto const n = uri::grammar::IPv6address({in.current(), in.size(46)}, addr);
+    if (n) {
+      in.bump(n);
+      return true;
+    }
+    return false;
+  }
+};
+
+// clang-format off
+
+//     IPvFuture     = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
+struct IPvFuture     : seq<one<'v'>, plus<HEXDIG>, one<'.'>, plus<sor<unreserved, sub_delims, one<':'>>>> {};
+
+//     IP-literal    = "[" ( IPv6address / IPvFuture  ) "]"
+struct IP_literal    : seq<one<'['>, sor<IPv6address, IPvFuture>, one<']'>> {};
+
+// RFC 6874 replaced the above rule with:
+
+//       ZoneID      = 1*( unreserved / pct-encoded )
+//struct ZoneID      : plus<sor<unreserved, pct_encoded>> {};
+
+//       IPv6addrz   = IPv6address "%25" ZoneID
+//struct IPv6addrz   : seq<IPv6address, one<'%'>, ZoneID> {};
+
+//     IP-literal    = "[" ( IPv6address / IPv6addrz / IPvFuture  ) "]"
+
+//     port          = *DIGIT
+// But actually, in the IP world, ports are unsigned 16 bit numbers.
+  struct port          : sor<seq<string<'6','5','5','3'>, range<'0','5'>>,
+                             seq<string<'6','5','5'>, range<'0','2'>, DIGIT>,
+                             seq<string<'6','5'>, range<'0', '4'>, rep<2, DIGIT>>,
+                             seq<one<'6'>, range<'0', '4'>, rep<3, DIGIT>>,
+                             seq<range<'0','5'>, rep<4, DIGIT>>,
+                             rep_min_max<0, 4, DIGIT>,
+                             TAO_PEGTL_STRING("00000")
+                             > {};
+
+//     host          = IP-literal / IPv4address / reg-name
+struct host          : sor<IP_literal, IPv4address, reg_name> {};
+
+//     userinfo      = *( unreserved / pct-encoded / sub-delims / ":" )
+struct userinfo      : star<sor<unreserved, pct_encoded, sub_delims, one<':'>>> {};
+
+// Use userinfo_at rule to trigger setting userinfo field only after '@' char is found.
+struct userinfo_at   : seq<userinfo, one<'@'>> {};
+
+//     authority     = [ userinfo "@" ] host [ ":" port ]
+struct authority     : seq<opt<userinfo_at>, host, opt<seq<one<':'>, port>>> {};
+
+//     scheme        = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+struct scheme        : seq<ALPHA, star<sor<ALPHA, DIGIT, one<'+', '-', '.'>>>> {};
+
+// Use scheme_colon rule to trigger setting scheme field only after ':' char is found.
+struct scheme_colon  : seq<scheme, one<':'>> {};
+
+//     relative-part = "//" authority path-abempty
+//                   / path-absolute
+//                   / path-noscheme
+//                   / path-abempty    ; this was added in Errata ID: 5428
+//                   / path-empty
+struct relative_part : sor<seq<two<'/'>, authority, path_abempty>,
+                           path_absolute,
+                           path_noscheme,
+                           path_abempty,
+                           path_empty> {};
+
+//     relative-ref  = relative-part [ "?" query ] [ "#" fragment ]
+struct relative_ref  : seq<relative_part, opt<seq<one<'?'>, query>>, opt<seq<one<'#'>, fragment>>> {};
+struct relative_ref_eof : seq<relative_ref, eof> {};
+
+//     hier-part     = "//" authority path-abempty
+//                   / path-absolute
+//                   / path-rootless
+//                   / path-empty
+struct hier_part     : sor<seq<two<'/'>, authority, path_abempty>,
+                           path_absolute,
+                           path_rootless,
+                           path_empty> {};
+
+//     absolute-URI  = scheme ":" hier-part [ "?" query ]
+struct absolute_URI  : seq<scheme_colon, hier_part, opt<seq<one<'?'>, query>>> {};
+struct absolute_URI_eof : seq<absolute_URI, eof> {};
+
+//     URI           = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+struct URI           : seq<scheme_colon, hier_part, opt<seq<one<'?'>, query>>, opt<seq<one<'#'>, fragment>>> {};
+struct URI_eof       : seq<URI, eof> {};
+
+//     URI-reference = URI / relative-ref
+struct URI_reference : sor<URI, relative_ref> {};
+struct URI_reference_eof : seq<URI_reference, eof> {};
+
+struct path_segment : seq<opt<one<'/'>>, seq<star<not_at<one<'/'>>, not_at<eof>, any>>> {};
+
+struct IP_literal_eof : seq<IP_literal, eof> {};
+
+// A single component on its own, for the uri::set_*() functions.
+struct host_eof      : seq<host, eof> {};
+struct query_eof     : seq<query, eof> {};
+struct path_abempty_eof : seq<path_abempty, eof> {};
+struct path_hier_eof : seq<sor<path_absolute, path_rootless, path_empty>, eof> {};
+struct path_rel_eof  : seq<sor<path_absolute, path_noscheme, path_empty>, eof> {};
+
+// clang-format on
+
+// Nothing unless port is one or more digits that fit in 16 bits.
+std::optional<std::uint16_t> port_number(std::string_view port);
+
+// Which host rule alternative matches all of host.  For IP addresses,
+// the binary form goes into addr.
+uri::host_kind classify_host(std::string_view host, uri::ip_address& addr);
+
+} // namespace uri_internal
+
+#endif // URI_INTERNAL_HPP_INCLUDED
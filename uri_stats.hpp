@@ -0,0 +1,135 @@
+#ifndef URI_STATS_HPP_INCLUDED
+#define URI_STATS_HPP_INCLUDED
+
+#include "dll_spec.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Counters and latency histograms for the library's hot paths.  Build
+// the library with -DURI_STATS to collect them; otherwise the hooks
+// compile to nothing and take_snapshot() returns all zeros.
+//
+// Each thread counts into its own block with relaxed atomic stores, so
+// no thread ever waits on another.  take_snapshot() adds up all the blocks,
+// including those of threads that have exited.
+
+namespace uri {
+namespace stats {
+
+enum class counter : std::uint8_t {
+  parse_generic,
+  parse_relative_ref,
+  parse_reference,
+  parse_absolute,
+  parse_failure, // any of the four
+  normalize,
+  resolve_ref,
+  resolve_merge, // resolve_ref took the merge(Base.path, R.path) branch
+  n_counters,
+};
+
+enum class stage : std::uint8_t {
+  parse,
+  normalize,
+  normalize_host,
+  normalize_pct_encoded,
+  nfkc,
+  idna,
+  remove_dot_segments,
+  resolve_ref,
+  n_stages,
+};
+
+constexpr auto n_counters = static_cast<std::size_t>(counter::n_counters);
+constexpr auto n_stages   = static_cast<std::size_t>(stage::n_stages);
+
+// Bucket i counts the calls that took [2^i, 2^(i+1)) nanoseconds, the
+// last bucket everything longer.
+struct histogram {
+  static constexpr std::size_t n_buckets = 32;
+
+  std::array<std::uint64_t, n_buckets> buckets{};
+  std::uint64_t                        count{0};
+  std::uint64_t                        total_ns{0};
+};
+
+struct snapshot {
+  std::array<std::uint64_t, n_counters> counters{};
+  std::array<histogram, n_stages>       latency{};
+
+  std::uint64_t operator[](counter c) const
+  {
+    return counters[static_cast<std::size_t>(c)];
+  }
+  histogram const& operator[](stage s) const
+  {
+    return latency[static_cast<std::size_t>(s)];
+  }
+};
+
+DLL_PUBLIC snapshot take_snapshot();
+
+DLL_PUBLIC std::string_view name(counter c);
+DLL_PUBLIC std::string_view name(stage s);
+
+constexpr bool enabled()
+{
+#ifdef URI_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace detail {
+DLL_PUBLIC void count(counter c);
+DLL_PUBLIC void record(stage s, std::uint64_t ns);
+
+class timer {
+public:
+  explicit timer(stage s)
+    : stage_(s)
+    , start_(std::chrono::steady_clock::now())
+  {
+  }
+  ~timer()
+  {
+    auto const elapsed = std::chrono::steady_clock::now() - start_;
+    record(stage_,
+           std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+               .count());
+  }
+
+  timer(timer const&) = delete;
+  timer& operator=(timer const&) = delete;
+
+private:
+  stage                                 stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+} // namespace detail
+
+} // namespace stats
+} // namespace uri
+
+// The hooks used inside the library.
+
+#ifdef URI_STATS
+#define URI_STATS_CAT_(a, b) a##b
+#define URI_STATS_CAT(a, b) URI_STATS_CAT_(a, b)
+#define URI_STATS_COUNT(c) ::uri::stats::detail::count(::uri::stats::counter::c)
+#define URI_STATS_TIME(s)                                                      \
+  ::uri::stats::detail::timer URI_STATS_CAT(uri_stats_timer_, __LINE__)        \
+  {                                                                            \
+    ::uri::stats::stage::s                                                     \
+  }
+#else
+#define URI_STATS_COUNT(c)
+#define URI_STATS_TIME(s)
+#endif
+
+#endif // URI_STATS_HPP_INCLUDED